@@ -486,8 +486,6 @@ var all_modules: defmodule_t [] = []
 var all_modules_sorted: int list = []
 var builtin_exceptions = empty_idmap
 var all_compile_errs: exn list = []
-var all_compile_err_ctx: string list = []
-var all_func_ctx: (id_t, typ_t, loc_t) list = []
 
 fun string(loc: loc_t)
 {
@@ -495,11 +493,138 @@ fun string(loc: loc_t)
     f"{fname}:{loc.line0}:{loc.col0}"
 }
 
+/*
+   all_names/all_strhash and the per-module symbol tables may be
+   extended from several threads when different modules are processed in parallel,
+   so the operations that add new names or new ids are protected with locks.
+   Note that the entries of a module symbol table should only be modified
+   by the thread that currently processes this module.
+*/
+@ccode {
+    static int_ fx_all_names_lock = 0;
+    static int_ fx_id_tables_lock = 0;
+    static int_ fx_tables_rwlock = 0;
+}
+
+@nothrow fun lock_all_names_(): void = @ccode { fx_spin_lock(&fx_all_names_lock) }
+@nothrow fun unlock_all_names_(): void = @ccode { fx_spin_unlock(&fx_all_names_lock) }
+@nothrow fun lock_id_tables(): void = @ccode { fx_spin_lock(&fx_id_tables_lock) }
+@nothrow fun unlock_id_tables(): void = @ccode { fx_spin_unlock(&fx_id_tables_lock) }
+@nothrow fun lock_tables_shared_(): void = @ccode { fx_spin_lock_shared(&fx_tables_rwlock) }
+@nothrow fun unlock_tables_shared_(): void = @ccode { fx_spin_unlock_shared(&fx_tables_rwlock) }
+@nothrow fun lock_tables_exclusive_(): void = @ccode { fx_spin_lock_exclusive(&fx_tables_rwlock) }
+@nothrow fun unlock_tables_exclusive_(): void = @ccode { fx_spin_unlock_exclusive(&fx_tables_rwlock) }
+
+@ccode {
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+    static int_ fx_typecheck_lock = 0;
+    static FX_THREAD_LOCAL int fx_typecheck_lock_depth = 0;
+    static int_ fx_last_thread_id = 0;
+    static FX_THREAD_LOCAL int_ fx_curr_thread_id = 0;
+
+    static int fx_thread_idx(void)
+    {
+        int idx = 0;
+    #ifdef _OPENMP
+        idx = omp_get_thread_num();
+    #endif
+        return idx;
+    }
+}
+
+// the maximum number of threads used by '@parallel for'
+@nothrow fun max_threads(): int = @ccode {
+    int_ n = 1;
+#ifdef _OPENMP
+    n = omp_get_max_threads();
+#endif
+    return n > 0 ? n : 1;
+}
+
+// index of the current thread within '@parallel for' (0 outside of it)
+@nothrow fun thread_idx(): int = @ccode { return fx_thread_idx(); }
+
+// unique id of the current thread; unlike thread_idx(), it's not reused by the other thread teams
+@nothrow fun thread_id(): int = @ccode {
+    if (fx_curr_thread_id == 0)
+        fx_curr_thread_id = FX_XADD(&fx_last_thread_id, 1) + 1;
+    return fx_curr_thread_id;
+}
+
+/*
+   Generic functions and variants are instantiated in the module where they are defined,
+   and the existing instances are reused by all the other modules.
+   When several modules are type-checked in parallel (see Compiler.typecheck_all()),
+   the search for an appropriate instance and creation of a new one
+   are done under this lock. Instantiation may trigger further instantiations,
+   so the lock is recursive: each thread counts how many times it has taken the lock.
+   The bodies of the new function instances are checked without the lock,
+   see Ast_typecheck.instantiate_fun_().
+*/
+@nothrow fun lock_typecheck(): void = @ccode {
+    if (fx_typecheck_lock_depth++ == 0)
+        fx_spin_lock(&fx_typecheck_lock);
+}
+@nothrow fun unlock_typecheck(): void = @ccode {
+    if (--fx_typecheck_lock_depth == 0)
+        fx_spin_unlock(&fx_typecheck_lock);
+}
+@nothrow fun typecheck_lock_depth(): int = @ccode { return fx_typecheck_lock_depth; }
+
+/*
+   The errors found in the currently processed module,
+   the instantiation context that is added to the error messages and
+   the stack of functions being checked are maintained separately for each thread
+*/
+var all_thread_compile_errs: exn list [] = array(max_threads(), ([]: exn list))
+var all_compile_err_ctx: string list [] = array(max_threads(), ([]: string list))
+var all_func_ctx: (id_t, typ_t, loc_t) list [] = array(max_threads(), ([]: (id_t, typ_t, loc_t) list))
+
+/*
+   While some modules are processed in parallel (see C_form.parallel_stage()),
+   a table that is reallocated by push() may be accessed by other threads at the same time
+   (e.g. when they look at the information about some function from another module).
+   So during the parallel stage the table entries are read and written under the shared lock,
+   and the tables are reallocated under the exclusive lock.
+*/
+var in_parallel_stage = false
+
+fun push_table_entry(tab: 't Dynvec.t): int =
+    if in_parallel_stage && tab.count >= size(tab.data) {
+        lock_tables_exclusive_()
+        val idx = try tab.push() finally { unlock_tables_exclusive_() }
+        idx
+    } else {
+        tab.push()
+    }
+
+fun table_entry(tab: 't Dynvec.t, idx: int): 't =
+    if in_parallel_stage {
+        lock_tables_shared_()
+        val x = try tab.data[idx] finally { unlock_tables_shared_() }
+        x
+    } else {
+        tab.data[idx]
+    }
+
+fun set_table_entry(tab: 't Dynvec.t, idx: int, x: 't): void =
+    if in_parallel_stage {
+        lock_tables_shared_()
+        try { tab.data[idx] = x } finally { unlock_tables_shared_() }
+    } else {
+        tab.data[idx] = x
+    }
+
 fun new_id_idx(midx: int) {
     if freeze_ids {
         throw Fail("internal error: attempt to add new AST id during K-phase or C code generation phase")
     }
-    all_modules[midx].dm_table.push()
+    lock_id_tables()
+    val idx = push_table_entry(all_modules[midx].dm_table)
+    unlock_id_tables()
+    idx
 }
 
 fun dump_id(i: id_t) {
@@ -510,7 +635,7 @@ fun dump_id(i: id_t) {
 fun id2str_(i: id_t, pp: bool): string =
     if i == noid { "<noid>" }
     else {
-        val prefix = all_names.data[i.i]
+        val prefix = table_entry(all_names, i.i)
         if pp || i.m == 0 { prefix }
         else { f"{prefix}@{i.j}" }
     }
@@ -518,12 +643,12 @@ fun id2str_(i: id_t, pp: bool): string =
 fun id2str_m(i: id_t): string =
     if i == noid { "<noid>" }
     else {
-        val prefix = all_names.data[i.i]
+        val prefix = table_entry(all_names, i.i)
         if i.m == 0 { prefix }
         else {
             val mprefix = pp(get_module_name(i.m))
             val mprefix = if mprefix == "Builtins" {""} else {mprefix + "."}
-            val prefix = all_names.data[i.i]
+            val prefix = table_entry(all_names, i.i)
             f"{mprefix}{prefix}@{i.j}"
         }
     }
@@ -533,7 +658,7 @@ fun pp(i: id_t): string = id2str_(i, true)
 
 fun compile_err(loc: loc_t, msg: string) {
     val whole_msg = f"{loc}: error: {msg}"
-    val whole_msg = match all_compile_err_ctx {
+    val whole_msg = match all_compile_err_ctx[thread_idx()] {
         | [] => whole_msg
         | ctx => "\n\t".join(whole_msg :: ctx)
         }
@@ -545,14 +670,25 @@ fun compile_warning(loc: loc_t, msg: string) {
     println(whole_msg)
 }
 
-fun push_compile_err(err: exn) { all_compile_errs = err :: all_compile_errs }
+fun push_compile_err(err: exn) {
+    val t = thread_idx()
+    all_thread_compile_errs[t] = err :: all_thread_compile_errs[t]
+}
 
 fun check_compile_errs() =
-    match all_compile_errs {
+    match all_thread_compile_errs[thread_idx()] {
         | err :: _ => throw PropagateCompileError
         | _ => {}
     }
 
+// takes the errors found by the current thread; the latest error goes first, as in all_compile_errs
+fun pop_thread_compile_errs(): exn list {
+    val t = thread_idx()
+    val errs = all_thread_compile_errs[t]
+    all_thread_compile_errs[t] = []
+    errs
+}
+
 fun print_compile_err(err: exn) {
     | CompileError(loc, msg) => println(msg)
     | Fail(msg) => println(f"Failure: {msg}")
@@ -578,23 +714,28 @@ fun id_info(i: id_t, loc: loc_t) =
     if i.m == 0 {IdNone}
     else {
         val (m, j) = id2idx_(i, loc)
-        all_modules[m].dm_table.data[j]
+        table_entry(all_modules[m].dm_table, j)
     }
 
 fun is_unique_id(i: id_t) = i.m > 0
 
 fun get_id_prefix(s: string): int
 {
+    lock_all_names_()
     val h_idx = all_strhash.find_idx_or_insert(s)
     val idx = all_strhash.table[h_idx].data
-    if idx >= 0 { idx }
-    else if lock_all_names == 0 {
-        val idx = all_names.push(s)
-        all_strhash.table[h_idx].data = idx
-        idx
-    } else {
+    val idx = if idx >= 0 || lock_all_names != 0 { idx }
+        else {
+            val idx = push_table_entry(all_names)
+            set_table_entry(all_names, idx, s)
+            all_strhash.table[h_idx].data = idx
+            idx
+        }
+    unlock_all_names_()
+    if idx < 0 {
         throw compile_err(noloc, "'all_names' are locked. Attempt to call get_id()")
     }
+    idx
 }
 
 fun get_id(s: string): id_t =
@@ -614,7 +755,7 @@ fun set_id_entry(i: id_t, n: id_info_t)
 {
     val loc = get_idinfo_loc(n)
     val (m_idx, idx) = id2idx_(i, loc)
-    all_modules[m_idx].dm_table.data[idx] = n
+    set_table_entry(all_modules[m_idx].dm_table, idx, n)
 }
 
 fun get_exp_ctx(e: exp_t)
@@ -1651,5 +1792,7 @@ fun init_all(): void
     all_modules_sorted = []
     builtin_exceptions = Map.empty(cmp_id)
     all_compile_errs = []
-    all_compile_err_ctx = []
+    all_thread_compile_errs = array(max_threads(), ([]: exn list))
+    all_compile_err_ctx = array(max_threads(), ([]: string list))
+    all_func_ctx = array(max_threads(), ([]: (id_t, typ_t, loc_t) list))
 }
@@ -18,7 +18,7 @@ fun ppid(pp: PP.t, x: id_t)
     val xstr =
         if x == noid { "<noid>" }
         else {
-            val prefix = all_names.data[x.i]
+            val prefix = table_entry(all_names, x.i)
             if x.m == 0 { prefix }
             else {
                 val m_prefix = pp_(get_module_name(x.m)) + "."
@@ -8,7 +8,7 @@
 from Ast import *
 import Ast_pp, Options
 
-import Filename, Map, Set, Hashset
+import Filename, Map, Set, Hashset, Sys
 
 /*
 The type checker component performs semantical analysis and various
@@ -104,7 +104,7 @@ type rec_elem_t = (val_flags_t, id_t, typ_t, exp_t)
 type rec_data_t = (rec_elem_t list, bool)
 
 fun maybe_unify(t1: typ_t, t2: typ_t, loc: loc_t, update_refs: bool): bool {
-    //val whole_ctx = "ctx:" + "\n\t".join(all_compile_err_ctx)
+    //val whole_ctx = "ctx:" + "\n\t".join(all_compile_err_ctx[thread_idx()])
     //print(f"\n<<<trying to unify types at {loc}; {whole_ctx}: "); Ast_pp.pprint_typ_x(t1, loc); print(" and "); Ast_pp.pprint_typ_x(t2, loc); println(); File.stdout.flush()
     var undo_stack: (typ_t? ref, typ_t?) list = []
     var rec_undo_stack: (rec_data_t ref, rec_data_t) list = []
@@ -574,16 +574,22 @@ fun find_typ_instance(t: typ_t, loc: loc_t): typ_t? {
         if targs == [] {
             Some(t)
         } else {
-            val inst_list = match id_info(n, loc) {
-                | IdVariant (ref {dvar_templ_inst}) => *dvar_templ_inst
-                | _ => []
-                }
-            match find_opt(for inst <- inst_list {
-                match id_info(inst, loc) {
-                | IdVariant (ref {dvar_alias=inst_alias}) =>
-                    maybe_unify(t, inst_alias, loc, false)
-                | _ => false
-                }}) {
+            lock_typecheck()
+            val inst_opt = try {
+                val inst_list = match id_info(n, loc) {
+                    | IdVariant (ref {dvar_templ_inst}) => *dvar_templ_inst
+                    | _ => []
+                    }
+                find_opt(for inst <- inst_list {
+                    match id_info(inst, loc) {
+                    | IdVariant (ref {dvar_alias=inst_alias}) =>
+                        maybe_unify(t, inst_alias, loc, false)
+                    | _ => false
+                    }})
+            } finally {
+                unlock_typecheck()
+            }
+            match inst_opt {
             | Some inst => Some(TypApp([], inst))
             | _ => None
             }
@@ -768,48 +774,56 @@ fun lookup_id_opt(n: id_t, t: typ_t, env: env_t, sc: scope_t list, loc: loc_t):
                 if df_templ_args == [] {
                     if maybe_unify(df_typ, t, loc, true) { Some((i, t)) } else { None }
                 } else {
-                    val (ftyp, env1) = preprocess_templ_typ(df_templ_args, df_typ, df_env, sc, loc)
-                    // first try to unify the type with the generic template type
-                    if !maybe_unify(ftyp, t, loc, true) { None }
-                    else {
-                        /* a necessary extra step to do before function instantiation;
-                            if it's a constructor, we first need to check the return type.
-                            this check may implicitly instantiate generic variant type, and so
-                            the df_templ_inst list of this constructor will be expanded with new instance.
-                            In theory, with such an extra step we should never enter
-                            'instantiate_fun' for constructors, because they all will be
-                            instantiated from check_typ => instantiate_variant => register_typ_constructor. */
-                        val return_orig =
-                            if !is_constructor(df_flags) {false}
+                    // the instances are shared by all the modules, see Ast.lock_typecheck()
+                    // and wait_for_instances()
+                    lock_typecheck()
+                    try {
+                        val (ftyp, env1) = preprocess_templ_typ(df_templ_args, df_typ, df_env, sc, loc)
+                        // first try to unify the type with the generic template type
+                        if !maybe_unify(ftyp, t, loc, true) { None }
+                        else {
+                            /* a necessary extra step to do before function instantiation;
+                                if it's a constructor, we first need to check the return type.
+                                this check may implicitly instantiate generic variant type, and so
+                                the df_templ_inst list of this constructor will be expanded with new instance.
+                                In theory, with such an extra step we should never enter
+                                'instantiate_fun' for constructors, because they all will be
+                                instantiated from check_typ => instantiate_variant => register_typ_constructor. */
+                            val return_orig =
+                                if !is_constructor(df_flags) {false}
+                                else {
+                                    match ftyp {
+                                    | TypFun(_, rt) =>
+                                        val _ = check_typ(rt, env1, sc, loc); false
+                                    | _ => !is_fixed_typ(t)
+                                    }
+                                }
+                            if return_orig { Some((df_name, t)) }
                             else {
-                                match ftyp {
-                                | TypFun(_, rt) =>
-                                    val _ = check_typ(rt, env1, sc, loc); false
-                                | _ => !is_fixed_typ(t)
+                                wait_for_instances(df_templ_inst, loc)
+                                val inst_name_opt = find_opt(for inst <- *df_templ_inst {
+                                    match id_info(inst, loc) {
+                                    | IdFun (ref {df_typ=inst_typ}) =>
+                                        maybe_unify(inst_typ, t, loc, true)
+                                    | _ => throw compile_err(loc, f"invalid (non-function) instance \
+                                                             {inst} of template function {pp(df_name)}")
+                                    }})
+                                match inst_name_opt {
+                                | Some(inst_name) => Some((inst_name, t))
+                                | _ =>
+                                    /* the generic function matches the requested type,
+                                        but there is no appropriate instance;
+                                        let's create a new one */
+                                    val inst_env = inst_merge_env(env, env1)
+                                    val { df_name=inst_name, df_typ=inst_typ } =
+                                        *instantiate_fun(df, ftyp, inst_env, loc, true)
+                                    unify(inst_typ, t, loc, "inconsistent type of the instantiated function")
+                                    Some((inst_name, t))
                                 }
                             }
-                        if return_orig { Some((df_name, t)) }
-                        else {
-                            val inst_name_opt = find_opt(for inst <- *df_templ_inst {
-                                match id_info(inst, loc) {
-                                | IdFun (ref {df_typ=inst_typ}) =>
-                                    maybe_unify(inst_typ, t, loc, true)
-                                | _ => throw compile_err(loc, f"invalid (non-function) instance \
-                                                         {inst} of template function {pp(df_name)}")
-                                }})
-                            match inst_name_opt {
-                            | Some(inst_name) => Some((inst_name, t))
-                            | _ =>
-                                /* the generic function matches the requested type,
-                                    but there is no appropriate instance;
-                                    let's create a new one */
-                                val inst_env = inst_merge_env(env, env1)
-                                val { df_name=inst_name, df_typ=inst_typ } =
-                                    *instantiate_fun(df, ftyp, inst_env, loc, true)
-                                unify(inst_typ, t, loc, "inconsistent type of the instantiated function")
-                                Some((inst_name, t))
-                            }
                         }
+                    } finally {
+                        unlock_typecheck()
                     }
                 }
             | IdModule _ =>
@@ -2118,7 +2132,7 @@ fun check_exp(e: exp_t, env: env_t, sc: scope_t list) {
     | ExpReturn(e_opt, _) =>
         unify(etyp, TypVoid, eloc, "return statement should has 'void' type")
         val t = match e_opt {|Some(e) => get_exp_typ(e) | _ => TypVoid}
-        match all_func_ctx {
+        match all_func_ctx[thread_idx()] {
         | (fname, rt, _) :: _ =>
             unify(t, rt, eloc,
                 f"the return statement type {typ2str(t)} is inconsistent with \
@@ -3059,21 +3073,26 @@ fun check_typ_and_collect_typ_vars(t: typ_t, env: env_t, r_opt_typ_vars: idset_t
                                 dvar_alias
                             } else if ty_args_are_real {
                                 val t1 = TypApp(ty_args, dvar_name)
-                                match dvar_templ_inst->find_opt(
-                                    fun (inst) {
-                                        match id_info(inst, dvar_loc) {
-                                        | IdVariant(dvar_inst) =>
-                                            val {dvar_alias=dvar_inst_alias} = *dvar_inst
-                                            maybe_unify(t1, dvar_inst_alias, dvar_loc, true)
-                                        | _ =>
-                                            throw compile_err(loc, f"invalid type of variant instance \
-                                                              {i} (must be also a variant)")
-                                        }
-                                    }) {
-                                | Some _ => t1
-                                | _ =>
-                                    val (_, inst_app_typ) = instantiate_variant(ty_args, dvar, r_env, sc, loc)
-                                    inst_app_typ
+                                lock_typecheck()
+                                try {
+                                    match dvar_templ_inst->find_opt(
+                                        fun (inst) {
+                                            match id_info(inst, dvar_loc) {
+                                            | IdVariant(dvar_inst) =>
+                                                val {dvar_alias=dvar_inst_alias} = *dvar_inst
+                                                maybe_unify(t1, dvar_inst_alias, dvar_loc, true)
+                                            | _ =>
+                                                throw compile_err(loc, f"invalid type of variant instance \
+                                                                  {i} (must be also a variant)")
+                                            }
+                                        }) {
+                                    | Some _ => t1
+                                    | _ =>
+                                        val (_, inst_app_typ) = instantiate_variant(ty_args, dvar, r_env, sc, loc)
+                                        inst_app_typ
+                                    }
+                                } finally {
+                                    unlock_typecheck()
                                 }
                             } else {
                                 TypApp(ty_args, dvar_name)
@@ -3135,21 +3154,76 @@ fun check_typ_and_collect_typ_vars(t: typ_t, env: env_t, r_opt_typ_vars: idset_t
 fun check_typ(t: typ_t, env: env_t, sc: scope_t list, loc: loc_t): typ_t =
     check_typ_and_collect_typ_vars(t, env, None, sc, loc, false).0
 
+/*
+   The function instances whose bodies are being checked without the lock
+   (see instantiate_fun_()), together with the ids of the threads that check them,
+   and the threads that wait for such instances, together with the threads they wait for.
+   Both lists are protected by Ast.lock_typecheck().
+*/
+var insts_in_progress: (id_t, int) list = []
+var threads_waiting: (int, int) list = []
+
+/*
+   Waits until the instances from 'insts' that are being checked by other threads are ready,
+   because their types may still be refined. It's called under the lock,
+   which is released while waiting. If the thread that checks an instance waits,
+   directly or indirectly, for the current thread (e.g. when two threads instantiate
+   mutually recursive generic functions from different ends), the waiting would never end,
+   so the instance is used right away, just like in the case of recursion within one thread.
+   The types of such instances are then shared by the threads until they are ready.
+*/
+fun wait_for_instances(insts: id_t list ref, loc: loc_t): void
+{
+    val me = thread_id()
+    fun waits_for_me(t: int): bool =
+        if t == me { true }
+        else {
+            match threads_waiting.assoc_opt(t) {
+            | Some(t2) => waits_for_me(t2)
+            | _ => false
+            }
+        }
+    fun busy_owner() =
+        fold owner = -1 for inst <- *insts {
+            if owner >= 0 { owner }
+            else {
+                match insts_in_progress.assoc_opt(inst) {
+                | Some(t) when !waits_for_me(t) => t
+                | _ => -1
+                }
+            }
+        }
+    var owner = busy_owner()
+    while owner >= 0 {
+        if typecheck_lock_depth() != 1 {
+            throw compile_err(loc, "internal error: cannot wait for the function instance \
+                              being checked by another thread while holding the lock")
+        }
+        threads_waiting = (me, owner) :: threads_waiting
+        unlock_typecheck()
+        Sys.sleep(1)
+        lock_typecheck()
+        threads_waiting = threads_waiting.filter(fun ((t, _)) {t != me})
+        owner = busy_owner()
+    }
+}
+
 fun instantiate_fun(templ_df: deffun_t ref, inst_ftyp: typ_t, inst_env0: env_t,
                     inst_loc: loc_t, instantiate: bool): deffun_t ref
 {
     val {df_name} = *templ_df
+    val t = thread_idx()
     if instantiate {
-        all_compile_err_ctx = f"when instantiating '{pp(df_name)}' at {inst_loc}" :: all_compile_err_ctx
+        all_compile_err_ctx[t] = f"when instantiating '{pp(df_name)}' at {inst_loc}" :: all_compile_err_ctx[t]
     }
-    all_func_ctx = (df_name, make_new_typ(), inst_loc) :: all_func_ctx
+    all_func_ctx[t] = (df_name, make_new_typ(), inst_loc) :: all_func_ctx[t]
     try {
         val inst_df = instantiate_fun_(templ_df, inst_ftyp, inst_env0,
                                        inst_loc, instantiate)
         inst_df
     } finally {
-        all_func_ctx = all_func_ctx.tl()
-        if instantiate { all_compile_err_ctx = all_compile_err_ctx.tl() }
+        all_func_ctx[t] = all_func_ctx[t].tl()
+        if instantiate { all_compile_err_ctx[t] = all_compile_err_ctx[t].tl() }
     }
 }
 
@@ -3225,13 +3299,24 @@ fun instantiate_fun_(templ_df: deffun_t ref, inst_ftyp: typ_t, inst_env0: env_t,
         })
     set_id_entry(inst_name, IdFun(inst_df))
     if instantiate { *templ_df->df_templ_inst = inst_name :: *templ_df->df_templ_inst }
-    match all_func_ctx {
+    match all_func_ctx[thread_idx()] {
     | (_, t, _) :: _ =>
         unify(t, rt, inst_loc, "the function body has inconsistent type; check the type of return statements")
     | _ => throw compile_err(df_loc, f"the function stack is empty for some reason")
     }
-    val inst_body = instantiate_fun_body(inst_name, inst_ftyp, df_inst_args,
-                                         inst_body, inst_env, fun_sc, inst_loc)
+    /* the new instance is already registered, so the lock is not needed while its body is checked;
+       other threads that need the instance wait until it's ready (see wait_for_instances()).
+       If the lock has also been taken by the outer code, it's kept */
+    val unlock_body = instantiate && typecheck_lock_depth() == 1
+    if instantiate { insts_in_progress = (inst_name, thread_id()) :: insts_in_progress }
+    if unlock_body { unlock_typecheck() }
+    val inst_body = try {
+            instantiate_fun_body(inst_name, inst_ftyp, df_inst_args,
+                                 inst_body, inst_env, fun_sc, inst_loc)
+        } finally {
+            if unlock_body { lock_typecheck() }
+            if instantiate { insts_in_progress = insts_in_progress.filter(fun ((i, _)) {i != inst_name}) }
+        }
     // update the function return type
     unify(get_exp_typ(inst_body), rt, inst_loc,
         "the function body has inconsistent type; \
@@ -3730,3 +3815,31 @@ fun check_mod(m_idx: int)
         all_modules[m_idx].dm_env = env
     } catch { | CompileError(_, _) as err => push_compile_err(err) | PropagateCompileError => {} }
 }
+
+/*
+   When the modules are checked in parallel (see Compiler.typecheck_all()),
+   the instances of generic functions and variants are created in unpredictable order.
+   Sort them by type, so that the produced code does not depend on this order.
+*/
+fun sort_templ_inst(m_idx: int)
+{
+    fun sort_insts(insts: id_t list, get_typ: id_t -> typ_t) =
+        match insts {
+        | [] | _ :: [] => insts
+        | _ =>
+            val keyed = [for i <- insts {(typ2str(get_typ(i)), i)}]
+            [for (_, i) <- keyed.sort(fun (a, b) {a.0 < b.0}) {i}]
+        }
+    val table = all_modules[m_idx].dm_table
+    for i <- 0:table.count {
+        match table.data[i] {
+        | IdFun (ref {df_templ_inst}) =>
+            *df_templ_inst = sort_insts(*df_templ_inst, fun (inst) {
+                match id_info(inst, noloc) { | IdFun (ref {df_typ}) => df_typ | _ => TypVoid }})
+        | IdVariant (ref {dvar_templ_inst}) =>
+            *dvar_templ_inst = sort_insts(*dvar_templ_inst, fun (inst) {
+                match id_info(inst, noloc) { | IdVariant (ref {dvar_alias}) => dvar_alias | _ => TypVoid }})
+        | _ => {}
+        }
+    }
+}
@@ -301,9 +301,11 @@ fun new_idc_idx(m_idx: int): int {
     if freeze_idcs {
         throw Fail("internal error: attempt to add new idc when they are frozen")
     }
-    val new_idx = all_modules[m_idx].dm_table.push()
-    val new_kidx = all_idks[m_idx].push()
-    val new_cidx = all_idcs[m_idx].push()
+    lock_id_tables()
+    val new_idx = push_table_entry(all_modules[m_idx].dm_table)
+    val new_kidx = push_table_entry(all_idks[m_idx])
+    val new_cidx = push_table_entry(all_idcs[m_idx])
+    unlock_id_tables()
     if new_idx == new_kidx && new_idx == new_cidx {
         new_idx
     } else {
@@ -311,10 +313,22 @@ fun new_idc_idx(m_idx: int): int {
     }
 }
 
+/*
+   Runs 'f' that processes several modules in parallel;
+   meanwhile the symbol tables are accessed under the locks
+   (see Ast.push_table_entry())
+*/
+fun parallel_stage(f: void -> 't): 't
+{
+    in_parallel_stage = true
+    val result = try f() finally { in_parallel_stage = false }
+    result
+}
+
 fun cinfo_(i: id_t, loc: loc_t)
 {
     val (m, j) = id2idx_(i, loc)
-    all_idcs[m].data[j]
+    table_entry(all_idcs[m], j)
 }
 
 fun gen_idc(m_idx: int, s: string): id_t
@@ -330,7 +344,7 @@ fun dup_idc(m_idx: int, old_id: id_t) =
 fun set_idc_entry(i: id_t, entry: cinfo_t)
 {
     val (m, j) = id2idx(i)
-    all_idcs[m].data[j] = entry
+    set_table_entry(all_idcs[m], j, entry)
 }
 
 fun init_all_idcs()
@@ -935,8 +949,8 @@ fun ctyp2str(t: ctyp_t, loc: loc_t) =
 fun idc2str(n: id_t, loc: loc_t) {
     val cname = get_idc_cname(n, loc)
     if cname != "" { cname }
-    else if n.m == 0 { all_names.data[n.i] }
-    else { f"{all_names.data[n.i]}_{n.j}" }
+    else if n.m == 0 { table_entry(all_names, n.i) }
+    else { f"{table_entry(all_names, n.i)}_{n.j}" }
 }
 
 fun ctyp2str_(t: ctyp_t, loc: loc_t): string = ctyp2str(t, loc).0
@@ -1045,6 +1059,7 @@ var std_FX_REC_VARIANT_TAG = noid
 var std_FX_MAKE_RECURSIVE_VARIANT_IMPL_START = noid
 var std_FX_MAKE_FP_IMPL_START = noid
 var std_FX_MAKE_FP_BY_FCV = noid
+var std_FX_MAKE_FP_ON_STACK = noid
 var std_FX_CALL = noid
 var std_FX_COPY_PTR = noid
 var std_FX_COPY_SIMPLE = noid
@@ -1113,6 +1128,7 @@ var std_FX_FREE_REF_SIMPLE = noid
 var std_fx_free_ref_simple = noid
 var std_FX_FREE_REF_IMPL = noid
 var std_FX_MAKE_REF_IMPL = noid
+var std_FX_MAKE_REF_ON_STACK = noid
 var std_FX_FREE_FP = noid
 var std_FX_COPY_FP = noid
 var std_fx_free_fp = noid
@@ -85,10 +85,10 @@
 from Ast import *
 from K_form import *
 from C_form import *
-import K_remove_unused, K_annotate, K_mangle, K_pp
-import C_gen_types, C_gen_fdecls, C_pp
+import K_remove_unused, K_annotate, K_escape, K_inline, K_mangle, K_pp
+import C_gen_types, C_gen_fdecls, C_pp, Options
 
-import Map, Set, Hashmap, Hashset
+import Filename, Map, Set, Hashmap, Hashset
 
 type count_map_t = (id_t, int) Hashmap.t
 
@@ -254,7 +254,7 @@ int main(int argc, char** argv)
 
 type cexp_map_t = (id_t, cexp_t) Hashmap.t
 
-fun gen_ccode(cmods: cmodule_t list, kmod: kmodule_t, c_fdecls: ccode_t, mod_init_calls: ccode_t)
+fun gen_ccode(prev_cnames: string list, kmod: kmodule_t, c_fdecls: ccode_t, mod_init_calls: ccode_t)
 {
     val {km_name, km_idx, km_cname, km_top, km_main} = kmod
     val cm_idx = km_idx
@@ -264,6 +264,9 @@ fun gen_ccode(cmods: cmodule_t list, kmod: kmodule_t, c_fdecls: ccode_t, mod_ini
     var fwd_fdecls: ccode_t = []
     var glob_data_ccode: ccode_t = []
     var module_cleanup: ccode_t = []
+    // the keys of the functions instrumented to count the calls (see -pgo-gen option)
+    var prof_keys: string list = []
+    val prof_counts = "_fx_prof_counts_" + K_mangle.mangle_mname(km_cname)
     var defined_syms = empty_id_hashset(1024)
     var i2e: cexp_map_t = Hashmap.empty(1024, noid, CExpTyp(CTypInt, noloc))
     val u1vals = find_single_use_vals(top_code)
@@ -3161,6 +3164,44 @@ fun gen_ccode(cmods: cmodule_t list, kmod: kmodule_t, c_fdecls: ccode_t, mod_ini
                     /* just put initialization into the global scope, no destructors are needed */
                     bctx->bctx_prologue = delta_ccode + bctx->bctx_prologue
                     ccode
+                } else if K_escape.stack_vals.mem(i) && !is_global && bctx->bctx_kind != BlockKind_Global {
+                    /* the closure or the reference that does not escape the current block (see K_escape.fx).
+                       Its data is put on stack and the captured values/the referenced value
+                       are released in the cleanup section of the block; 'i' itself needs no destructor */
+                    val (i_exp, ccode) = create_cdefval(i, ctyp, kv_flags, "", None, ccode, kloc)
+                    val (data_ctyp, data_elems, make_m, make_args) =
+                        match e2 {
+                        | KExpMkClosure (_, f, args, _) =>
+                            val fcv_t_id =
+                                match kinfo_(f, kloc) {
+                                | KFun (ref {kf_closure={kci_fcv_t}}) => kci_fcv_t
+                                | _ => throw compile_err(kloc, f"cgen: '{get_idk_cname(f, kloc)}' is not a function")
+                                }
+                            val relems =
+                                match cinfo_(fcv_t_id, kloc) {
+                                | CTyp (ref {ct_typ=CTypStruct (_, relems), ct_data_start}) => relems.skip(ct_data_start)
+                                | _ => throw compile_err(kloc, f"cgen: invalid closure data type '{get_idk_cname(fcv_t_id, kloc)}'")
+                                }
+                            ensure_sym_is_defined_or_declared(f, kloc)
+                            (CTypName(fcv_t_id), [for ce <- relems, a <- args {(ce, a)}],
+                            std_FX_MAKE_FP_ON_STACK, [make_id_t_exp(f, std_CTypVoidPtr, kloc)])
+                        | KExpUnary (OpMkRef, a, _) =>
+                            val (rn, _, relems, _) = get_struct(i_exp)
+                            (CTypName(rn), [(relems.last(), a)], std_FX_MAKE_REF_ON_STACK, [])
+                        | _ => throw compile_err(kloc, f"cgen: unexpected initializer of stack-allocated '{idk2str(i, kloc)}'")
+                        }
+                    val data_id = gen_idc(cm_idx, pp(i) + "_data")
+                    val (data_exp, prologue) = create_cdefval(data_id, data_ctyp, default_tempval_flags(), "",
+                                                    Some(CExpInit([], (data_ctyp, kloc))), bctx->bctx_prologue, kloc)
+                    bctx->bctx_prologue = prologue
+                    val make_exp = make_call(make_m, make_args + [data_exp, i_exp], CTypVoid, kloc)
+                    val fold ccode = CExp(make_exp) :: ccode for ((n, t), a) <- data_elems {
+                        val (ca, ccode) = atom2cexp(a, ccode, kloc)
+                        val elem_exp = cexp_mem(data_exp, n, t)
+                        bctx->bctx_cleanup = C_gen_types.gen_free_code(elem_exp, t, true, false, bctx->bctx_cleanup, kloc)
+                        C_gen_types.gen_copy_code(ca, elem_exp, t, ccode, kloc)
+                    }
+                    ccode
                 } else if is_fast_cons || (is_temp_ref || ktp_scalar && is_temp) && u1vals.mem(i) {
                     val (ce2, ccode) = kexp2cexp(e2, ref None, ccode)
                     /* we still need to declare i to be able to access its type */
@@ -3309,6 +3350,14 @@ fun gen_ccode(cmods: cmodule_t list, kmod: kmodule_t, c_fdecls: ccode_t, mod_ini
                 val (status_exp, ccode) = create_cdefval(orig_status_id, CTypCInt, default_tempvar_flags(),
                                                         "fx_status", Some(make_int_exp(0, kf_loc)), [], kf_loc)
                 val status_id = if is_nothrow { noid } else { orig_status_id }
+                val ccode =
+                    if !Options.opt.pgo_gen {
+                        ccode
+                    } else {
+                        val prof_idx = prof_keys.length()
+                        prof_keys = K_inline.profile_key(kf_name, kf_loc) :: prof_keys
+                        CExp(CExpCCode(f"FX_PROF_INC({prof_counts}[{prof_idx}]);", kf_loc)) :: ccode
+                    }
                 val ccode =
                     if status_id == noid || !kf_flags.fun_flag_recursive {
                         ccode
@@ -3594,7 +3643,21 @@ fun gen_ccode(cmods: cmodule_t list, kmod: kmodule_t, c_fdecls: ccode_t, mod_ini
                 else { CStmtLabel(bctx_label, end_loc) :: ccode }
     val ccode = filter_out_nops(ccode)
     val ccode = bctx_cleanup + ccode
-    val deinit_ccode = module_cleanup
+    /* in the instrumented application the call counters are stored to the profile
+       when the module is deinitialized */
+    val nprof = prof_keys.length()
+    val (prof_decls, prof_defs, deinit_ccode) =
+        if nprof == 0 { ([], [], module_cleanup) }
+        else {
+            val prof_keys_arr = "_fx_prof_keys_" + K_mangle.mangle_mname(km_cname)
+            val prof_fname = Filename.normalize(Options.opt.pgo_dir, K_mangle.mangle_mname(km_cname) + ".fxprof")
+            val keys_init = ", ".join([for k <- prof_keys.rev() {k.escaped()}])
+            ([CExp(CExpCCode(f"FX_EXTERN_C_VAL(uint64_t {prof_counts}[{nprof}])", end_loc))],
+             [CExp(CExpCCode(f"uint64_t {prof_counts}[{nprof}];\n" +
+                             f"static const char* {prof_keys_arr}[] = {{{keys_init}}};", end_loc))],
+             CExp(CExpCCode(f"fx_prof_dump({prof_fname.escaped()}, {nprof}, {prof_keys_arr}, {prof_counts});",
+                            end_loc)) :: module_cleanup)
+        }
     val ccode = CStmtReturn(Some(status_exp), end_loc) :: ccode
     val km_cname = K_mangle.mangle_mname(km_cname)
     val init_cname = "fx_init_" + km_cname
@@ -3614,16 +3677,132 @@ fun gen_ccode(cmods: cmodule_t list, kmod: kmodule_t, c_fdecls: ccode_t, mod_ini
             cf_loc=end_loc })
     set_idc_entry(init_name, CFun(init_f))
     set_idc_entry(deinit_name, CFun(deinit_f))
-    val mod_names = if km_main { km_cname :: [for {cmod_cname} <- cmods { cmod_cname } ] }
+    val mod_names = if km_main { km_cname :: prev_cnames }
                     else { [] }
-    val all_ccode_prologue = gen_ccode_prologue(km_main, start_loc) + top_inline_ccode.rev()
-    val all_ccode = global_vars + fwd_fdecls.rev() + glob_data_ccode.rev() +
-                    c_fdecls + [CDefFun(init_f), CDefFun(deinit_f) ] +
-                    gen_main(km_main, mod_names, end_loc)
-    (all_ccode_prologue, all_ccode)
+    /* the produced code is returned in pieces, so that the module can be split into
+       several translation units if needed (see split_ccode()) */
+    (gen_ccode_prologue(km_main, start_loc), top_inline_ccode.rev(), global_vars,
+     prof_decls + fwd_fdecls.rev() + glob_data_ccode.rev(), c_fdecls,
+     prof_defs + [CDefFun(init_f), CDefFun(deinit_f) ] + gen_main(km_main, mod_names, end_loc))
+}
+
+/* Splits the code of a big module into several parts that can be compiled in parallel.
+   The first part is the module itself with all the global definitions, inline C code,
+   the functions that contain C code (they may use the definitions from the inline C code),
+   the initialization and deinitialization functions and main(). The other functions are
+   distributed between the parts in the original order, so that all the parts have
+   approximately the same size. Each part is prepended with the common declarations:
+   the types, the global data, the external declarations of the module's global values and
+   the forward declarations of all the functions that the part does not define.
+   The static functions are made extern, because they may be called from another part.
+   Returns the list of parts, where the first part is the module itself */
+fun split_ccode(prologue: ccode_t, inline_ccode: ccode_t, ctypes: ccode_t, global_vars: ccode_t,
+                decls: ccode_t, fdefs: ccode_t, epilogue: ccode_t, max_size: int): ccode_t list
+{
+    var size = 0
+    var have_ccode = false
+    fun count_cexp(e: cexp_t, callb: c_fold_callb_t) =
+        match e {
+        | CExpCCode _ => have_ccode = true
+        | _ => fold_cexp(e, callb)
+        }
+    fun count_cstmt(s: cstmt_t, callb: c_fold_callb_t)
+    {
+        size += 1
+        fold_cstmt(s, callb)
+    }
+    val count_callb = c_fold_callb_t {
+        ccb_fold_ident=None,
+        ccb_fold_typ=None,
+        ccb_fold_exp=Some(count_cexp),
+        ccb_fold_stmt=Some(count_cstmt)
+    }
+    // for each function, find its size (the number of statements) and whether it can be moved
+    val fsizes = [for s <- fdefs {
+        size = 0
+        have_ccode = false
+        count_cstmt(s, count_callb)
+        match s {
+        | CDefFun _ => (size, !have_ccode)
+        | _ => (size, false)
+        }
+    }]
+    val fold total_size = 0, fixed_size = 0 for (sz, movable) <- fsizes {
+        (total_size + sz, if movable {fixed_size} else {fixed_size + sz})
+    }
+    val nparts = (total_size + max_size - 1)/max(max_size, 1)
+    if max_size <= 0 || nparts <= 1 || fixed_size == total_size {
+        (prologue + inline_ccode + ctypes + global_vars + decls + fdefs + epilogue) :: []
+    } else {
+        val part_size = (total_size + nparts - 1)/nparts
+        val parts = array(nparts, ([]: ccode_t))
+        // the parts only contain functions; the other definitions from fdefs are put into each part
+        var curr = 0, curr_size = fixed_size
+        for s <- fdefs, (sz, movable) <- fsizes {
+            match s {
+            | CDefFun _ =>
+                if !movable {
+                    parts[0] = s :: parts[0]
+                } else {
+                    if curr_size > 0 && curr_size + sz > part_size && curr < nparts - 1 {
+                        curr += 1
+                        curr_size = 0
+                    }
+                    parts[curr] = s :: parts[curr]
+                    curr_size += sz
+                }
+            | _ => {}
+            }
+        }
+        for s <- fdefs {
+            | CDefFun cf =>
+                val {cf_flags} = *cf
+                if cf_flags.fun_flag_private {
+                    *cf = cf->{cf_flags=cf_flags.{fun_flag_private=false}}
+                }
+            | _ => {}
+        }
+        // the global values are defined in the first part and declared as external in the others.
+        // the anonymous private values (e.g. the data of global variant constants)
+        // are only used in the initializers of other global values, so they stay static
+        fun extern_decl(s: cstmt_t) =
+            match s {
+            | CDefVal (_, n, _, loc) =>
+                match cinfo_(n, loc) {
+                | CVal ({cv_flags, cv_cname} as cv) when cv_cname != "" =>
+                    if cv_flags.val_flag_private {
+                        set_idc_entry(n, CVal(cv.{cv_flags=cv_flags.{val_flag_private=false}}))
+                    }
+                    CDefForwardSym(n, loc)
+                | _ => CStmtNop(loc)
+                }
+            | _ => s
+            }
+        val extern_vals = filter_out_nops([for s <- global_vars { extern_decl(s) }])
+        val other_fdecls = filter_out_nops([for s <- fdefs { | CDefFun _ => CStmtNop(noloc) | _ => s }])
+        val extern_fdecls = filter_out_nops([for s <- other_fdecls { extern_decl(s) }])
+        [for part_code@k <- parts {
+            val part_code = part_code.rev()
+            val defined = empty_id_hashset(256)
+            for s <- part_code { | CDefFun cf => defined.add(cf->cf_name) | _ => {} }
+            val fwd_decls = [for s <- fdefs {
+                | CDefFun cf when !defined.mem(cf->cf_name) => CDefForwardSym(cf->cf_name, cf->cf_loc)
+                | _ => CStmtNop(noloc)
+                }]
+            val fwd_decls = filter_out_nops(fwd_decls)
+            if k == 0 {
+                prologue + inline_ccode + ctypes + global_vars + decls +
+                    other_fdecls + fwd_decls + part_code + epilogue
+            } else {
+                prologue + ctypes + extern_vals + decls + extern_fdecls + fwd_decls + part_code
+            }
+        }]
+    }
 }
 
-fun gen_ccode_all(kmods: kmodule_t list): cmodule_t list
+/* Returns the list of C modules for each K-form module: the module itself,
+   followed by its parts when the module is split (see split_ccode()) */
+fun gen_ccode_all(kmods: kmodule_t list): cmodule_t list list
 {
     /* 1. convert all types to C from all modules */
     val (all_ctypes_fwd_decl, all_ctypes_decl, all_ctypes_fun_decl) = C_gen_types.convert_all_typs(kmods)
@@ -3638,22 +3817,95 @@ fun gen_ccode_all(kmods: kmodule_t list): cmodule_t list
         }
     pr_verbose("\tfunction declarations and exceptions have been translated to C")
 
-    /* 3. convert each module to C */
-    val fold cmods = [] for (km, c_fdecls, mod_init_calls, exn_data_decls) <- kmods_plus.rev() {
-        val {km_name, km_cname, km_main, km_skip, km_pragmas} = km
-        val (prologue, ccode) = gen_ccode(cmods, km, c_fdecls, mod_init_calls)
-        val ctypes = C_gen_types.elim_unused_ctypes(km.km_name, all_ctypes_fwd_decl,
-                            all_ctypes_decl + exn_data_decls, all_ctypes_fun_decl, ccode)
-        (cmodule_t {
-            cmod_name=km_name,
-            cmod_cname=K_mangle.mangle_mname(km_cname),
-            cmod_ccode=prologue + (ctypes + ccode),
-            cmod_main=km_main,
-            cmod_recompile=true,
-            cmod_skip=km_skip,
-            cmod_pragmas=km_pragmas
-        }) :: cmods
+    /* 3. convert each module to C. C descriptions of the global values are created
+       when the module that defines them is converted, so the modules are split into levels:
+       the modules at each level only depend on the modules at the previous levels.
+       The levels are processed one by one, and the modules at each level are processed in parallel.
+       Each module gets the new C ids only in its own symbol table,
+       so the produced code does not depend on the order of processing.
+       The main module needs the names of all the other modules
+       (in the reverse order) to call their initialization functions */
+    val kmods_plus = array(kmods_plus.rev())
+    val nmods = size(kmods_plus)
+    val fold prev_cnames = [] for (km, _, _, _) <- kmods_plus {
+        K_mangle.mangle_mname(km.km_cname) :: prev_cnames
+    }
+    val mod_levels = array(size(all_modules), 0)
+    for (km, _, _, _) <- kmods_plus {
+        mod_levels[km.km_idx] = fold l = 0 for d <- km.km_deps { max(l, mod_levels[d] + 1) }
+    }
+    val nlevels = fold nlevels = 0 for (km, _, _, _) <- kmods_plus { max(nlevels, mod_levels[km.km_idx] + 1) }
+    val cmods = array(nmods, ([]: cmodule_t list))
+    for level <- 0:nlevels {
+        val level_mods = array([for (km, _, _, _)@i <- kmods_plus when mod_levels[km.km_idx] == level {i}])
+        val level_results = parallel_stage(fun () {
+            [| @parallel for i <- level_mods {
+                val (km, c_fdecls, mod_init_calls, exn_data_decls) = kmods_plus[i]
+                val {km_name, km_cname, km_main, km_skip, km_pragmas} = km
+                try {
+                    val prev_cnames = if km_main { prev_cnames.skip(nmods - i) } else { [] }
+                    val (prologue, inline_ccode, global_vars, decls, fdefs, epilogue) =
+                        gen_ccode(prev_cnames, km, c_fdecls, mod_init_calls)
+                    val ccode = global_vars + decls + fdefs + epilogue
+                    val cname = K_mangle.mangle_mname(km_cname)
+                    if Options.opt.unity {
+                        // in the unity mode the types are defined once for all the modules, see below
+                        ([cmodule_t {
+                            cmod_name=km_name, cmod_cname=cname,
+                            cmod_ccode=inline_ccode + ccode,
+                            cmod_main=km_main, cmod_recompile=true,
+                            cmod_skip=false, cmod_pragmas=km_pragmas
+                        }], [])
+                    } else {
+                        val ctypes = C_gen_types.elim_unused_ctypes(km_name, all_ctypes_fwd_decl,
+                                            all_ctypes_decl + exn_data_decls, all_ctypes_fun_decl, ccode)
+                        val max_size = if km_skip {0} else {Options.opt.split_c}
+                        val parts = split_ccode(prologue, inline_ccode, ctypes, global_vars,
+                                                decls, fdefs, epilogue, max_size)
+                        ([for part_code@k <- parts {
+                            cmodule_t {
+                                cmod_name=km_name,
+                                cmod_cname=if k == 0 {cname} else {f"{cname}.{k}"},
+                                cmod_ccode=part_code,
+                                cmod_main=km_main && k == 0,
+                                cmod_recompile=true,
+                                cmod_skip=km_skip,
+                                cmod_pragmas=km_pragmas
+                            }}], [])
+                    }
+                } catch {
+                | e => ([], e :: [])
+                }
+            } |]
+        })
+        // report the error in the first failed module, if any
+        for (cmod, errs)@j <- level_results {
+            match errs {
+            | e :: _ => throw e
+            | _ => cmods[level_mods[j]] = cmod
+            }
+        }
     }
     pr_verbose("\tall modules have been translated")
-    cmods.rev()
+    if !Options.opt.unity {
+        [for parts <- cmods {parts}]
+    } else {
+        val fold all_cmods = [] for parts <- cmods { parts.rev() + all_cmods }
+        /* in the unity mode all the modules are concatenated (in the dependency order, so that
+           the main module is the last one) into a single translation unit, which lets C compiler
+           to inline functions across modules. The types and their helper functions
+           are defined just once in the very beginning */
+        val fold all_code = [], any_cpp = false, all_clibs = [] for cmod <- all_cmods {
+            val {cmod_ccode, cmod_pragmas={pragma_cpp, pragma_clibs}} = cmod
+            (cmod_ccode + all_code, any_cpp || pragma_cpp, pragma_clibs + all_clibs)
+        }
+        val main_cmod = all_cmods.hd()
+        val ctypes = C_gen_types.elim_unused_ctypes(main_cmod.cmod_name, all_ctypes_fwd_decl,
+                            all_ctypes_decl, all_ctypes_fun_decl, all_code)
+        [[main_cmod.{
+            cmod_cname=main_cmod.cmod_cname + ".unity",
+            cmod_ccode=gen_ccode_prologue(true, noloc) + ctypes + all_code,
+            cmod_pragmas=pragmas_t {pragma_cpp=any_cpp, pragma_clibs=all_clibs}
+        }]]
+    }
 }
@@ -48,6 +48,7 @@ fun init_std_names(): void {
     std_FX_MAKE_RECURSIVE_VARIANT_IMPL_START = gen_std_macro("FX_MAKE_RECURSIVE_VARIANT_IMPL_START", 1)
     std_FX_MAKE_FP_IMPL_START = gen_std_macro("FX_MAKE_FP_IMPL_START", 3)
     std_FX_MAKE_FP_BY_FCV = gen_std_macro("FX_MAKE_FP_BY_FCV", 3)
+    std_FX_MAKE_FP_ON_STACK = gen_std_macro("FX_MAKE_FP_ON_STACK", 3)
     std_FX_CALL = gen_std_macro("FX_CALL", 2)
     std_FX_COPY_PTR = gen_std_macro("FX_COPY_PTR", 2)
     std_FX_COPY_SIMPLE = gen_std_macro("FX_COPY_SIMPLE", 2)
@@ -122,6 +123,7 @@ fun init_std_names(): void {
     std_fx_free_ref_simple = gen_std_fun("fx_free_ref_simple", std_CTypVoidPtr :: [], CTypVoid)
     std_FX_FREE_REF_IMPL = gen_std_macro("FX_FREE_REF_IMPL", 2)
     std_FX_MAKE_REF_IMPL = gen_std_macro("FX_MAKE_REF_IMPL", 2)
+    std_FX_MAKE_REF_ON_STACK = gen_std_macro("FX_MAKE_REF_ON_STACK", 2)
     std_FX_FREE_FP = gen_std_macro("FX_FREE_FP", 1)
     std_FX_COPY_FP = gen_std_macro("FX_COPY_FP", 2)
     std_fx_free_fp = gen_std_fun("fx_free_fp", std_CTypVoidPtr :: [], CTypVoid)
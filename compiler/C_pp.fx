@@ -207,10 +207,10 @@ type assoc_t = AssocLeft | AssocRight
         | KLitNil _ => pp.str("0")
         | KLitChar c => pp.str(f"(char_){ord(c)}")
         | KLitString s0 =>
-            val sl = s0.split('\n', allow_empty=true)
-            if sl == [] {pp.str(s0.escaped(quotes=true))}
+            val sl = s0.split_array('\n', allow_empty=true)
+            val n = size(sl)
+            if n == 0 {pp.str(s0.escaped(quotes=true))}
             else {
-                val n = sl.length()
                 for s@i <- sl {
                     val s = if i < n-1 || s0.endswith('\n') {s+"\n"} else {s}
                     val s = s.escaped(quotes=true)
@@ -630,3 +630,16 @@ fun pprint_top_to_string(code: ccode_t): string
     val all_lines = pp.get_f()
     join_embrace("", "\n", "\n", all_lines)
 }
+
+// computes hash of pprint_top_to_string(code) without actually forming the text
+fun pprint_top_to_hash(code: ccode_t): hash_t
+{
+    val pp = PP.pprint_to_hash(ccode_margin, default_indent=default_indent)
+    pp.beginv(0)
+    for s@i <- code {
+        if i != 0 { pp.break0() }
+        pp_cstmt_(pp, s)
+    }
+    pp.newline(); pp.end()
+    pp.hash()
+}
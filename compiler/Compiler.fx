@@ -6,13 +6,14 @@
 // Ficus compiler, the driving part
 // (calls all other parts of the compiler in the proper order)
 
-import Filename, File, Sys, Hashmap, LexerUtils as Lxu
+import Filename, File, Sys, Hashmap, Hashset, LexerUtils as Lxu
 import Ast, Ast_pp, Lexer, Parser, Options
 import Ast_typecheck
 import K_form, K_pp, K_normalize, K_annotate, K_mangle
 import K_remove_unused, K_lift_simple, K_flatten, K_tailrec, K_copy_n_skip
 import K_cfold_dealias, K_fast_idx, K_inline, K_loop_inv, K_fuse_loops
 import K_optim_matop, K_nothrow_wrappers, K_freevars, K_declosure, K_lift
+import K_const_regex, K_specialize, K_escape
 import C_form, C_gen_std, C_gen_code, C_pp
 import C_post_rename_locals, C_post_adjust_decls
 
@@ -184,10 +185,44 @@ fun toposort(graph: dep_graph_t): int list
     result.rev()
 }
 
+/*
+   The modules are split into levels, so that the modules at each level only depend
+   on the modules at the previous levels. The levels are checked one by one,
+   and the modules at each level are checked in parallel.
+   Generic functions and variants are looked up and registered under the lock
+   (see Ast.lock_typecheck()), while the bodies of the new function instances are checked
+   without it (see Ast_typecheck.wait_for_instances()). The rest of the type checker state
+   is kept per thread, and in the end the instances are sorted
+   (see Ast_typecheck.sort_templ_inst()). When some module fails, the next levels are not checked
+   and only the errors of the first failed module at the level are reported,
+   so the output does not depend on the number of threads.
+*/
 fun typecheck_all(modules: int list): bool
 {
     Ast.all_compile_errs = []
-    for m <- modules {Ast_typecheck.check_mod(m)}
+    val mod_levels = array(size(Ast.all_modules), 0)
+    for m <- modules {
+        mod_levels[m] = fold l = 0 for d <- Ast.all_modules[m].dm_deps { max(l, mod_levels[d] + 1) }
+    }
+    val nlevels = fold nlevels = 0 for m <- modules { max(nlevels, mod_levels[m] + 1) }
+    for level <- 0:nlevels {
+        val level_mods = array([for m <- modules when mod_levels[m] == level {m}])
+        val level_errs = C_form.parallel_stage(fun () {
+            [| @parallel for m <- level_mods {
+                try {
+                    Ast_typecheck.check_mod(m)
+                } catch {
+                | e => Ast.push_compile_err(e)
+                }
+                Ast.pop_thread_compile_errs()
+            } |]
+        })
+        for errs <- level_errs {
+            if Ast.all_compile_errs == [] { Ast.all_compile_errs = errs }
+        }
+        if Ast.all_compile_errs != [] { break }
+    }
+    for m <- modules { Ast_typecheck.sort_templ_inst(m) }
     Ast.all_compile_errs == []
 }
 
@@ -199,14 +234,75 @@ fun k_normalize_all(modules: int list): (kmodule_t list, bool)
     (kmods, Ast.all_compile_errs == [])
 }
 
+// The build manifest contains hashes of the K-forms and the generated C code
+// of all the modules from the previous build. It lets to find out
+// that a module has not changed without forming the text
+// and reading the previously written .k and .c files.
+var build_manifest: (string, string) Hashmap.t = Hashmap.empty(256, "", "")
+
+fun build_manifest_filename() = Filename.normalize(Options.opt.build_dir, "build.manifest")
+
+fun load_build_manifest(): void
+{
+    build_manifest.clear()
+    val fname = build_manifest_filename()
+    if !Options.opt.force_rebuild && Filename.exists(fname) {
+        val lines = try File.read_utf8(fname).split('\n', allow_empty=false)
+                    catch {| IOError | FileOpenError => []}
+        for l <- lines {
+            val sep = l.find(' ')
+            if sep > 0 { build_manifest.add(l[:sep], l[sep+1:].strip()) }
+        }
+    }
+}
+
+fun save_build_manifest(): void
+{
+    val lines = [for (k, h) <- build_manifest.list() {f"{k} {h}"}]
+    val lines = lines.sort(fun (a, b) {a < b})
+    try File.write_utf8(build_manifest_filename(), join_embrace("", "\n", "\n", lines))
+    catch {| IOError | FileOpenError => {}}
+}
+
+// Module interface, i.e. all the top-level definitions without the function bodies
+// and the value initializers. The C code of a module depends on the interfaces of
+// other modules, but not on their implementation, so when the implementation changes,
+// the dependent modules do not have to be recompiled.
+// Note that only the generation and the compilation of C code are skipped this way;
+// all the modules, changed or not, are still parsed, type-checked and converted to K-form.
+// [TODO] store the interfaces in the build directory and load them instead of
+// processing the unchanged dependencies from scratch
+fun kmodule_interface(km_top: K_form.kcode_t): K_form.kcode_t =
+    [for e <- km_top {
+        // the constants that can be substituted into other modules are a part of the interface
+        // (see K_cfold_dealias.find_exported_consts_all())
+        | K_form.KDefVal(n, _, _) when K_cfold_dealias.exported_consts.mem(n) => e
+        | K_form.KDefVal(n, _, loc) => K_form.KDefVal(n, K_form.KExpNop(loc), loc)
+        // the bodies of small functions that can be expanded in other modules
+        // (see K_copy_n_skip.find_exported_funcs()) are a part of the interface
+        | K_form.KDefFun kf when K_copy_n_skip.exported_funcs.mem(kf->kf_name) => e
+        | K_form.KDefFun kf => K_form.KDefFun(ref kf->{kf_body=K_form.KExpNop(kf->kf_loc)})
+        | K_form.KDefExn _ | K_form.KDefTyp _ | K_form.KDefVariant _
+        | K_form.KDefInterface _ | K_form.KDefClosureVars _ => e
+        | _ => K_form.KExpNop(K_form.get_kexp_loc(e))
+    }]
+
 fun k_skip_some(kmods: kmodule_t list)
 {
     val skip_flags = array(size(Ast.all_modules), false)
+    // true if the interface of the module or some of its dependencies has changed
+    val iface_changed = array(size(Ast.all_modules), false)
     val build_root_dir = Options.opt.build_rootdir
     val ok = Sys.mkdir(build_root_dir, 0755)
     val build_dir = Options.opt.build_dir
     var ok = ok && Sys.mkdir(build_dir, 0755)
     val obj_ext = if Sys.win32 {".obj"} else {".o"}
+    if ok { load_build_manifest() }
+    K_remove_unused.used_by_skipped = Ast.empty_id_hashset(256)
+    // the produced code also depends on the K-form optimization options
+    val kopts = f"{Options.opt.optimize_level}|{Options.opt.optim_iters}|{Options.opt.inline_thresh}"
+    val same_kopts = build_manifest.find_opt("kopts") == Some(kopts)
+    build_manifest.add("kopts", kopts)
 
     val kmods = [ for km <- kmods {
         val {km_idx, km_cname, km_top, km_deps, km_pragmas} = km
@@ -218,48 +314,63 @@ fun k_skip_some(kmods: kmodule_t list)
         val c_filename = cname + ext
         val o_filename = cname + obj_ext
 
-        val new_kform = K_pp.pp_top_to_string(km_top)
-        val have_k = Filename.exists(k_filename)
+        val k_key = Filename.basename(k_filename)
+        val new_hash = string(K_pp.pp_top_to_hash(km_top))
         val have_c = Filename.exists(c_filename)
         val have_o = Filename.exists(o_filename)
-        val have_all = have_k & have_c & have_o
+        // if the module has been split into several parts (see C_gen_code.split_ccode()),
+        // all the parts need to be present
+        val nparts = build_manifest.find_opt(mname + ":parts").value_or("1").to_int_or(1)
+        val have_parts = all(for k <- 1:nparts {
+            Filename.exists(f"{cname}.{k}{ext}") && Filename.exists(f"{cname}.{k}{obj_ext}")})
+        val have_all = !Options.opt.force_rebuild & same_kopts & have_c & have_o & have_parts
 
-        val old_kform =
-            if Options.opt.force_rebuild || !have_all {""}
-            else {
-                try
-                    File.read_utf8(k_filename)
-                catch {
-                | IOError | FileOpenError => ""
-                }
-            }
-        val (ok_j, same_kform, status_j) =
-            if new_kform == old_kform {
-                (true, true, "")
+        // normally the K-form hash is compared with the hash stored in the build manifest;
+        // the previously dumped K-form is only read when there is no such record
+        val same_kform = have_all && (match build_manifest.find_opt(k_key) {
+            | Some(old_hash) => new_hash == old_hash
+            | _ =>
+                Filename.exists(k_filename) &&
+                (try File.read_utf8(k_filename) catch {| IOError | FileOpenError => ""}) ==
+                K_pp.pp_top_to_string(km_top)
+            })
+        val (ok_j, status_j) =
+            if same_kform {
+                (true, "")
             } else {
                 val well_written =
                     try {
-                        File.write_utf8(k_filename, new_kform)
+                        File.write_utf8(k_filename, K_pp.pp_top_to_string(km_top))
                         true
                     }
                     catch {
                     | IOError | FileOpenError => false
                     }
-                (well_written, false,
-                if well_written {""} else {clrmsg(MsgRed, "failed to write .k")})
+                (well_written, if well_written {""} else {clrmsg(MsgRed, "failed to write .k")})
             }
+        build_manifest.add(k_key, new_hash)
+        val iface_key = mname + ".api"
+        val iface_hash = string(K_pp.pp_top_to_hash(kmodule_interface(km_top)))
+        iface_changed[km_idx] = build_manifest.find_opt(iface_key) != Some(iface_hash) ||
+                                exists(for d <- km_deps {iface_changed[d]})
+        build_manifest.add(iface_key, iface_hash)
         ok = ok & ok_j
         if !same_kform {
             if have_c { Sys.remove(c_filename) }
             if have_o { Sys.remove(o_filename) }
         }
-        // [TODO] with properly constructed K-form dump format it should be
-        // not necessary to check the dependencies. Types of the dependencies from
-        // other modules (basically, their API) could be included into the dump.
-        val skip_module = same_kform && all(for d <- km_deps {skip_flags[d]})
+        // the module can be skipped even if some of its dependencies are processed,
+        // as long as their interfaces are the same
+        // in the unity mode the code of all the modules is needed to form the single C file;
+        // the instrumented code and the code optimized using the profile are always regenerated
+        val skip_module = same_kform && !Options.opt.unity &&
+                          !Options.opt.pgo_gen && !Options.opt.pgo_use &&
+                          !exists(for d <- km_deps {iface_changed[d]})
         val status_j = if status_j != "" {status_j} else if skip_module {"skip"} else {clrmsg(MsgBlue, "process")}
         pr_verbose(f"K {km_cname}: {status_j}")
         if skip_module {
+            K_form.used_by(km_top, 256).app(fun (i) {
+                if i.m != km_idx { K_remove_unused.used_by_skipped.add(i) }})
             for e <- km_top {
                 | K_form.KDefFun kf when kf->kf_flags.fun_flag_ctor == Ast.CtorNone =>
                     val {kf_flags, kf_rt, kf_loc} = *kf
@@ -278,79 +389,180 @@ fun k_skip_some(kmods: kmodule_t list)
     } ]
 
     if !ok {throw Fail("failed to write some k-forms")}
+    save_build_manifest()
     kmods
 }
 
 fun prf(str: string) = pr_verbose(f"\t{str}")
 
+// statistics collected when -time-passes option is specified
+type pass_stat_t =
+{
+    ps_name: string; // name of the compilation stage or optimization pass
+    ps_iter: int; // optimization iteration or 0 for the passes that are run once
+    ps_time: double; // wall time, in seconds
+    ps_alloc: int64; // the number of bytes allocated during the pass
+    ps_ksize: int // the number of K-form expressions after the pass or -1
+}
+
+var all_pass_stats: pass_stat_t list = []
+
+fun no_ksize(_: 't) = -1
+fun kmods_size(kmods: kmodule_t list) =
+    fold sz = 0 for km <- kmods { sz + K_form.count_kexps(km.km_top) }
+
+fun timed_pass(name: string, iter: int, f: void -> 't, ksize: 't -> int): 't
+{
+    if !Options.opt.time_passes { f() }
+    else {
+        val t0 = Sys.tick_count(), a0 = Sys.allocated_bytes()
+        val result = f()
+        val t = (Sys.tick_count() - t0)/Sys.tick_frequency()
+        val alloc = Sys.allocated_bytes() - a0
+        all_pass_stats = pass_stat_t {ps_name=name, ps_iter=iter, ps_time=t,
+                            ps_alloc=alloc, ps_ksize=ksize(result)} :: all_pass_stats
+        result
+    }
+}
+
+fun kpass(name: string, iter: int, kmods: kmodule_t list,
+          f: kmodule_t list -> kmodule_t list): kmodule_t list
+{
+    prf(name)
+    timed_pass(name, iter, fun () {f(kmods)}, kmods_size)
+}
+
+/*
+   Runs the pass that processes each module independently on all the modules in parallel.
+   If the pass fails on some modules, the exception for the first of them is rethrown,
+   so that the reported error does not depend on the order, in which the modules are processed.
+*/
+fun kpass_par(name: string, iter: int, kmods: kmodule_t list,
+              f: kmodule_t list -> kmodule_t list): kmodule_t list
+{
+    prf(name)
+    timed_pass(name, iter, fun () {
+        val results = C_form.parallel_stage(fun () {
+            [| @parallel for km <- array(kmods) {
+                try {
+                    (f(km :: []).hd(), [])
+                } catch {
+                | e => (km, e :: [])
+                }
+            } |]
+        })
+        for (_, errs) <- results {
+            | (_, e :: _) => throw e
+            | _ => {}
+        }
+        [for (km, _) <- results {km}]
+    }, kmods_size)
+}
+
+fun print_pass_stats()
+{
+    fun lpad(s: string, w: int) = if s.length() >= w {s} else {" "*(w-s.length()) + s}
+    fun rpad(s: string, w: int) = if s.length() >= w {s} else {s + " "*(w-s.length())}
+    // formats non-negative number with 1 digit after the decimal point
+    fun fixed1(x: double) {
+        val r = round(x*10)
+        f"{r/10}.{r%10}"
+    }
+    val stats = all_pass_stats.rev()
+    val fold total_time = 0., total_alloc = 0L for {ps_time, ps_alloc} <- stats {
+        (total_time + ps_time, total_alloc + ps_alloc)
+    }
+    val mb = 1024.*1024
+    val hline = "-"*88
+    println(hline)
+    println(rpad("Stage/pass", 40) + lpad("Iter", 6) + lpad("Time, ms", 12) +
+            lpad("%", 8) + lpad("Alloc, MB", 12) + lpad("K-size", 10))
+    println(hline)
+    for {ps_name, ps_iter, ps_time, ps_alloc, ps_ksize} <- stats {
+        val iter = if ps_iter > 0 {string(ps_iter)} else {""}
+        val ksize = if ps_ksize >= 0 {string(ps_ksize)} else {""}
+        val percent = if total_time > 0. {ps_time*100/total_time} else {0.}
+        println(rpad(ps_name, 40) + lpad(iter, 6) + lpad(fixed1(ps_time*1000), 12) +
+                lpad(fixed1(percent), 8) + lpad(fixed1(ps_alloc/mb), 12) + lpad(ksize, 10))
+    }
+    println(hline)
+    println(rpad("Total", 46) + lpad(fixed1(total_time*1000), 12) +
+            lpad("100.0", 8) + lpad(fixed1(total_alloc/mb), 12))
+
+    val json_fname = Options.opt.time_passes_json
+    if json_fname != "" {
+        val passes = [for {ps_name, ps_iter, ps_time, ps_alloc, ps_ksize} <- stats {
+            f"    {{\"name\": {ps_name.escaped()}, \"iter\": {ps_iter}, \"time_ms\": {ps_time*1000}, \
+\"alloc_bytes\": {ps_alloc}, \"ksize\": {ps_ksize}}}"
+            }]
+        val json = f"{{\n  \"total_time_ms\": {total_time*1000},\n" +
+            f"  \"total_alloc_bytes\": {total_alloc},\n  \"passes\": [\n" +
+            ",\n".join(passes) + "\n  ]\n}\n"
+        try {
+            File.write_utf8(json_fname, json)
+        } catch {
+        | IOError | FileOpenError => println(f"{error}: failed to write {json_fname}")
+        }
+    }
+}
+
 fun k_optimize_all(kmods: kmodule_t list): (kmodule_t list, bool) {
     Ast.all_compile_errs = []
     val niters = Options.opt.optim_iters
     var temp_kmods = kmods
-    prf("remove unused")
-    temp_kmods = K_remove_unused.remove_unused(temp_kmods, true)
-    prf("annotate types")
-    temp_kmods = K_annotate.annotate_types(temp_kmods)
-    prf("copy generic/inline functions")
-    temp_kmods = K_copy_n_skip.copy_some(temp_kmods)
-    prf("remove unused by main")
-    temp_kmods = K_remove_unused.remove_unused_by_main(temp_kmods)
-    prf("mangle & dump intermediate K-forms")
-    temp_kmods = K_mangle.mangle_all(temp_kmods, false)
-    temp_kmods = K_mangle.mangle_locals(temp_kmods)
-    temp_kmods = k_skip_some(temp_kmods)
-    prf("demangle")
-    temp_kmods = K_mangle.demangle_all(temp_kmods)
+    temp_kmods = kpass("remove unused", 0, temp_kmods,
+        fun (kmods) {K_remove_unused.remove_unused(kmods, true)})
+    temp_kmods = kpass("annotate types", 0, temp_kmods, K_annotate.annotate_types)
+    temp_kmods = kpass("copy generic/inline functions", 0, temp_kmods, K_copy_n_skip.copy_some)
+    temp_kmods = kpass("remove unused by main", 0, temp_kmods, K_remove_unused.remove_unused_by_main)
+    temp_kmods = kpass("hoist constant regexps", 0, temp_kmods, K_const_regex.hoist_const_regex_all)
+    temp_kmods = kpass("find exported constants", 0, temp_kmods, K_cfold_dealias.find_exported_consts_all)
+    temp_kmods = kpass("mangle & dump intermediate K-forms", 0, temp_kmods,
+        fun (kmods) {
+            val kmods = K_mangle.mangle_all(kmods, false)
+            val kmods = K_mangle.mangle_locals(kmods)
+            k_skip_some(kmods)
+        })
+    temp_kmods = kpass("demangle", 0, temp_kmods, K_mangle.demangle_all)
     for i <- 1: niters+1 {
         pr_verbose(f"Optimization pass #{i}:")
         if i <= 2 {
-            prf("simple lambda lifting")
-            temp_kmods = K_lift_simple.lift(temp_kmods)
-        }
-        prf("tailrec")
-        temp_kmods = K_tailrec.tailrec2loops_all(temp_kmods)
-        prf("loop inv")
-        temp_kmods = K_loop_inv.move_loop_invs_all(temp_kmods)
-        prf("gemm implantation")
-        temp_kmods = K_optim_matop.optimize_gemm(temp_kmods)
-        prf("inline")
+            temp_kmods = kpass("simple lambda lifting", i, temp_kmods, K_lift_simple.lift)
+        }
+        temp_kmods = kpass_par("tailrec", i, temp_kmods, K_tailrec.tailrec2loops_all)
+        temp_kmods = kpass_par("loop inv", i, temp_kmods, K_loop_inv.move_loop_invs_all)
+        temp_kmods = kpass("gemm implantation", i, temp_kmods, K_optim_matop.optimize_gemm)
         if Options.opt.inline_thresh > 0 {
-            temp_kmods = K_inline.inline_some(temp_kmods)
-        }
-        prf("flatten")
-        temp_kmods = K_flatten.flatten_all(temp_kmods)
-        prf("fuse loops")
-        temp_kmods = K_fuse_loops.fuse_loops_all(temp_kmods)
-        prf("fast idx")
-        temp_kmods = K_fast_idx.optimize_idx_checks_all(temp_kmods)
-        prf("const folding")
-        temp_kmods = K_cfold_dealias.cfold_dealias(temp_kmods)
-        prf("remove unused")
-        temp_kmods = K_remove_unused.remove_unused(temp_kmods, false)
+            temp_kmods = kpass("specialize", i, temp_kmods, K_specialize.specialize_all)
+            temp_kmods = kpass("inline", i, temp_kmods, K_inline.inline_some)
+        } else {
+            prf("specialize")
+            prf("inline")
+        }
+        temp_kmods = kpass_par("flatten", i, temp_kmods, K_flatten.flatten_all)
+        temp_kmods = kpass_par("fuse loops", i, temp_kmods, K_fuse_loops.fuse_loops_all)
+        temp_kmods = kpass_par("fast idx", i, temp_kmods, K_fast_idx.optimize_idx_checks_all)
+        temp_kmods = kpass("const folding", i, temp_kmods, K_cfold_dealias.cfold_dealias)
+        temp_kmods = kpass("remove unused", i, temp_kmods,
+            fun (kmods) {K_remove_unused.remove_unused(kmods, false)})
     }
     pr_verbose("Finalizing K-form:")
-    prf("linearize array access")
-    temp_kmods = K_fast_idx.linearize_arrays_access(temp_kmods)
-    prf("making wrappers for nothrow functions")
-    temp_kmods = K_nothrow_wrappers.make_wrappers_for_nothrow(temp_kmods)
-    prf("mutable freevars referencing")
-    temp_kmods = K_freevars.mutable_freevars2refs(temp_kmods)
-    prf("declosuring")
-    temp_kmods = K_declosure.declosure_all(temp_kmods)
-    prf("lambda lifting")
-    temp_kmods = K_lift.lift_all(temp_kmods)
-    prf("flatten")
-    temp_kmods = K_flatten.flatten_all(temp_kmods)
-    prf("remove unused")
-    temp_kmods = K_remove_unused.remove_unused(temp_kmods, false)
-    prf("mangle")
-    temp_kmods = K_mangle.mangle_all(temp_kmods, true)
-    prf("remove unused")
-    temp_kmods = K_remove_unused.remove_unused(temp_kmods, false)
-    prf("mark recursive")
-    temp_kmods = K_inline.find_recursive_funcs_all(temp_kmods)
-    prf("annotate types")
-    temp_kmods = K_annotate.annotate_types(temp_kmods)
+    temp_kmods = kpass_par("linearize array access", 0, temp_kmods, K_fast_idx.linearize_arrays_access)
+    temp_kmods = kpass("making wrappers for nothrow functions", 0, temp_kmods,
+        K_nothrow_wrappers.make_wrappers_for_nothrow)
+    temp_kmods = kpass("mutable freevars referencing", 0, temp_kmods, K_freevars.mutable_freevars2refs)
+    temp_kmods = kpass("declosuring", 0, temp_kmods, K_declosure.declosure_all)
+    temp_kmods = kpass("lambda lifting", 0, temp_kmods, K_lift.lift_all)
+    temp_kmods = kpass_par("flatten", 0, temp_kmods, K_flatten.flatten_all)
+    temp_kmods = kpass("remove unused", 0, temp_kmods,
+        fun (kmods) {K_remove_unused.remove_unused(kmods, false)})
+    temp_kmods = kpass("mangle", 0, temp_kmods,
+        fun (kmods) {K_mangle.mangle_all(kmods, true)})
+    temp_kmods = kpass("remove unused", 0, temp_kmods,
+        fun (kmods) {K_remove_unused.remove_unused(kmods, false)})
+    temp_kmods = kpass("mark recursive", 0, temp_kmods, K_inline.find_recursive_funcs_all)
+    temp_kmods = kpass("annotate types", 0, temp_kmods, K_annotate.annotate_types)
+    temp_kmods = kpass("escape analysis", 0, temp_kmods, K_escape.find_stack_vals_all)
     (temp_kmods, Ast.all_compile_errs == [])
 }
 
@@ -360,8 +572,20 @@ fun k2c_all(kmods: kmodule_t list)
     Ast.all_compile_errs = []
     C_form.init_all_idcs()
     C_gen_std.init_std_names()
-    val cmods = C_gen_code.gen_ccode_all(kmods)
+    val all_parts = C_gen_code.gen_ccode_all(kmods)
     pr_verbose(clrmsg(MsgBlue, "C code generated"))
+    // a skipped module is not split again, but its previously compiled parts still need to be linked;
+    // for the other modules the number of parts is stored in the build manifest
+    val cmods = [for parts <- all_parts {
+        | cmod :: [] when cmod.cmod_skip =>
+            val nparts = build_manifest.find_opt(cmod.cmod_cname + ":parts").value_or("1").to_int_or(1)
+            cmod :: [for k <- 1:nparts {
+                cmod.{cmod_cname=f"{cmod.cmod_cname}.{k}", cmod_ccode=[], cmod_main=false}}]
+        | cmod :: _ =>
+            build_manifest.add(cmod.cmod_cname + ":parts", string(parts.length()))
+            parts
+        | _ => []
+        }].concat()
     val cmods = C_post_rename_locals.rename_locals(cmods)
     val cmods = [for cmod <- cmods {
         val is_cpp = Options.opt.compile_by_cpp || cmod.cmod_pragmas.pragma_cpp
@@ -372,6 +596,278 @@ fun k2c_all(kmods: kmodule_t list)
     (cmods, Ast.all_compile_errs == [])
 }
 
+// The shared cache of object files. The object files are stored there under the names
+// derived from the hash of the C code, the runtime headers, the C compiler and the flags,
+// so that the same code (e.g. the runtime or the standard library) is compiled just once
+// for all the applications and all the build directories.
+val OBJ_CACHE_DEFAULT_SIZE_MB = 1024
+
+fun obj_cache_dir(): string
+{
+    val dir = Sys.getenv("FICUS_CACHE_DIR")
+    val dir = if dir != "" {dir} else {
+        val home = Sys.getenv(if Sys.win32 {"LOCALAPPDATA"} else {"HOME"})
+        if home == "" {""}
+        else if Sys.win32 {Filename.concat(home, "ficus")}
+        else {
+            val cache_root = Filename.concat(home, ".cache")
+            if Sys.mkdir(cache_root, 0755) {Filename.concat(cache_root, "ficus")} else {""}
+        }
+    }
+    if dir != "" && Sys.mkdir(dir, 0755) {dir} else {""}
+}
+
+// computes hash of the C file and all the files it includes, directly or indirectly,
+// using '#include "..."' or '#include <...>'. The included files are searched in
+// the directory of the including file (only for '#include "..."') and then in 'incdirs';
+// the files that are not found there (the system headers) and the files from 'known' are skipped.
+// Returns the hash and the list of all the visited files, including 'known'
+fun hash_c_source(fname: string, incdirs: string list, known: string list): (hash_t, string list)
+{
+    var visited = known
+    fun find_include(fname: string, name: string, quoted: bool): string
+    {
+        val local_name = Filename.normalize(Filename.dirname(fname), name)
+        if quoted && Filename.exists(local_name) {local_name}
+        else {
+            fold found = "" for dir <- incdirs {
+                val inc_name = Filename.normalize(dir, name)
+                if found == "" && Filename.exists(inc_name) {inc_name} else {found}
+            }
+        }
+    }
+    fun hash_file(fname: string, h0: hash_t): hash_t =
+        if visited.mem(fname) || !Filename.exists(fname) {h0}
+        else {
+            visited = fname :: visited
+            val text = try File.read_utf8(fname) catch {| IOError | FileOpenError => ""}
+            var h = (h0 ^ hash(text)) * FNV_1A_PRIME
+            var pos = text.find("#include")
+            while pos >= 0 {
+                var start = pos + 8
+                while start < text.length() && text[start] == ' ' { start += 1 }
+                val quoted = start < text.length() && text[start] == '"'
+                val end = if quoted {text.find('"', start + 1)}
+                          else if start < text.length() && text[start] == '<' {text.find('>', start + 1)}
+                          else {-1}
+                if end > start {
+                    val name = find_include(fname, text[start+1:end], quoted)
+                    if name != "" { h = hash_file(name, h) }
+                }
+                pos = text.find("#include", max(end, start))
+            }
+            h
+        }
+    val h = hash_file(fname, FNV_1A_OFFSET)
+    (h, visited)
+}
+
+// the first line of '<comp> --version' output, which is used to distinguish object files
+// produced by different versions of the C compiler
+fun cc_version_string(comp: string): string =
+    if Sys.win32 {comp}
+    else {
+        try {
+            val p = File.popen(f"{comp} --version 2>&1", "rt")
+            val str = p.readln().strip()
+            ignore(p.pclose_exit_status())
+            str
+        } catch {
+        | _ => comp
+        }
+    }
+
+// Profile-guided optimization. The instrumented application (see -pgo-gen) stores
+// the C compiler's profile data (.gcda files or, in the case of clang, .profraw files)
+// and the function call counters (.fxprof files, one per module) to the profile directory.
+// The counters are used by K_inline (see -pgo-use).
+val profile_exts = [".gcda", ".profraw", ".profdata", ".fxprof"]
+
+// gcc may put the .gcda files into subdirectories of the profile directory
+fun list_profile_files(dir: string): string list
+{
+    val entries = try Filename.listdir(dir) catch {| FileOpenError => []}
+    fold files = [] for f <- entries.sort(fun (a, b) {a < b}) {
+        val fname = Filename.normalize(dir, f)
+        if exists(for ext <- profile_exts {f.endswith(ext)}) {fname :: files}
+        else {list_profile_files(fname) + files}
+    }
+}
+
+fun clear_profile(dir: string): void =
+    for f <- list_profile_files(dir) { Sys.remove(f) }
+
+// the hash of the profile file names, sizes and modification times
+fun profile_signature(dir: string): string
+{
+    val fold h = FNV_1A_OFFSET for f <- list_profile_files(dir) {
+        hash(f"{h}|{f}|{Filename.getsize(f)}|{Filename.getmtime(f)}")
+    }
+    string(h)
+}
+
+// clang stores the raw profiles that need to be merged before use
+fun merge_clang_profiles(dir: string): void
+{
+    val entries = try Filename.listdir(dir) catch {| FileOpenError => []}
+    val rawfiles = [for f <- entries when f.endswith(".profraw") {Filename.normalize(dir, f)}]
+    if rawfiles != [] {
+        val output = Filename.normalize(dir, "default.profdata")
+        val cmd = f"llvm-profdata merge -output={output} " + " ".join(rawfiles)
+        if Sys.command(cmd) != 0 {
+            pr_verbose(clrmsg(MsgRed, "failed to merge the raw profiles with llvm-profdata"))
+        }
+    }
+}
+
+// loads the function call counters collected by the instrumented application
+fun load_profile(dir: string): void
+{
+    K_inline.profile = Hashmap.empty(1024, "", 0)
+    K_inline.profile_max = 0
+    val entries = try Filename.listdir(dir) catch {| FileOpenError => []}
+    if entries == [] { pr_verbose(clrmsg(MsgRed, f"the profile directory '{dir}' is empty or does not exist")) }
+    for f <- entries {
+        if f.endswith(".fxprof") {
+            val lines = try File.read_utf8(Filename.normalize(dir, f)).split('\n', allow_empty=false)
+                        catch {| IOError | FileOpenError => []}
+            for l <- lines {
+                val sep = l.rfind(' ')
+                if sep > 0 {
+                    val idx = K_inline.profile.find_idx_or_insert(l[:sep])
+                    val count = K_inline.profile.table[idx].data + l[sep+1:].strip().to_int_or(0)
+                    K_inline.profile.table[idx].data = count
+                    K_inline.profile_max = max(K_inline.profile_max, count)
+                }
+            }
+        }
+    }
+}
+
+// copies the file via a temporary file, so that other processes never see a partially written file
+fun copy_file(src: string, dst: string): bool =
+    try {
+        val data = File.read_binary_u8(src)
+        val tmp = f"{dst}.{Sys.tick_count()}.tmp"
+        val f = File.open(tmp, "wb")
+        f.write(data)
+        f.close()
+        try {
+            ignore(Sys.rename(tmp, dst))
+        } catch {
+        // on Windows rename() fails if the destination file exists
+        | IOError =>
+            if Filename.exists(dst) { Sys.remove(dst) }
+            try ignore(Sys.rename(tmp, dst)) catch {| IOError => Sys.remove(tmp); throw IOError}
+        }
+        true
+    } catch {
+    | _ => false
+    }
+
+// removes the least recently used object files from the cache, when it becomes too big.
+// Each cache hit updates the modification time of the entry, see run_cc().
+// The approximate size of the cache is stored in a stamp file and updated by each build
+// with the size of the added object files, so the whole cache is only listed
+// when the size may exceed the limit (or when there is no stamp yet)
+val OBJ_CACHE_SIZE_STAMP = "cache_size.txt"
+
+fun trim_obj_cache(cache_dir: string, obj_ext: string, added: int64): void
+{
+    val max_size = int64(Sys.getenv("FICUS_CACHE_SIZE").to_int_or(OBJ_CACHE_DEFAULT_SIZE_MB))*1048576L
+    val stamp = Filename.normalize(cache_dir, OBJ_CACHE_SIZE_STAMP)
+    val old_total = try File.read_utf8(stamp).strip().to_int_or(-1) catch {| IOError | FileOpenError => -1}
+    val new_total =
+        if old_total >= 0 && int64(old_total) + added <= max_size {
+            int64(old_total) + added
+        } else {
+            val entries = try Filename.listdir(cache_dir) catch {| _ => []}
+            val entries = [for name <- entries when name.endswith(obj_ext) {
+                val fname = Filename.normalize(cache_dir, name)
+                (Filename.getmtime(fname), Filename.getsize(fname), fname)
+            }]
+            val fold total = 0L for (_, sz, _) <- entries {total + sz}
+            var total = total
+            if total > max_size {
+                val entries = entries.sort(fun ((t1, _, _), (t2, _, _)) {t1 < t2})
+                for (_, sz, fname) <- entries {
+                    if total <= max_size*3/4 {break}
+                    try Sys.remove(fname) catch {| IOError => {}}
+                    total -= sz
+                }
+            }
+            total
+        }
+    if old_total < 0 || new_total != int64(old_total) {
+        // several builds may update the stamp at once, but it's just an estimate
+        try File.write_utf8(stamp, string(new_total)) catch {| IOError | FileOpenError => {}}
+    }
+}
+
+// runs the compilation commands (each job is the index of the module and the command)
+// and returns the success flags and the time, in milliseconds, for all the modules
+fun run_cc_jobs(jobs: (int, string) list, nmodules: int, use_cl: bool): (bool, int) []
+{
+    val results = array(nmodules, (false, 0))
+    fun elapsed_ms(t0: int64) = int((Sys.tick_count() - t0)*1000/Sys.tick_frequency())
+    if use_cl || !Sys.unix {
+        val jobs = array(jobs)
+        val jobs_results = [| @parallel for (_, cmd) <- jobs {
+            val t0 = Sys.tick_count()
+            val result =
+                if use_cl {
+                    val p = File.popen(cmd, "rt")
+                    var lineno = 0
+                    // read and immediately dump the output from cl,
+                    // except for the first line, which is the source file name
+                    while true {
+                        val str = p.readln()
+                        if str == "" { break }
+                        lineno += 1
+                        if lineno > 1 {print(str)}
+                    }
+                    p.pclose_exit_status() == 0
+                } else {
+                    Sys.command(cmd) == 0
+                }
+            (result, elapsed_ms(t0))
+        } |]
+        for (i, _)@k <- jobs { results[i] = jobs_results[k] }
+    } else {
+        // the compiler processes are started directly (without a shell and an extra thread each),
+        // and the number of simultaneously running processes is limited
+        val max_jobs = if Options.opt.jobs > 0 {Options.opt.jobs}
+                       else {max(Sys.ncpus() - int(max(Sys.loadavg(), 0.)), 1)}
+        pr_verbose(f"Running up to {max_jobs} C compiler processes at once")
+        var pending = jobs
+        var running: (int, int, int64) list = []
+        while pending != [] || running != [] {
+            while pending != [] && running.length() < max_jobs {
+                val (i, cmd) = pending.hd()
+                pending = pending.tl()
+                try {
+                    running = (Sys.spawn(cmd), i, Sys.tick_count()) :: running
+                } catch {
+                | IOError => results[i] = (false, 0)
+                }
+            }
+            if running != [] {
+                val (pid, status) = try Sys.wait_any([| for (p, _, _) <- running {p} |]) catch {| NotFoundError => (-1, -1)}
+                if pid < 0 {
+                    // should not happen; the processes are lost somehow
+                    running = []
+                } else {
+                    for (p, i, t0) <- running {
+                        if p == pid { results[i] = (status == 0, elapsed_ms(t0)) }
+                    }
+                    running = running.filter(fun ((p, _, _)) {p != pid})
+                }
+            }
+        }
+    }
+    results
+}
+
 // [TODO] add proper support for Windows
 fun run_cc(cmods: C_form.cmodule_t list, ficus_root: string) {
     val osinfo = Sys.osname(true)
@@ -394,7 +890,9 @@ fun run_cc(cmods: C_form.cmodule_t list, ficus_root: string) {
                 } else {
                     " /MT " + (if opt_level == 1 {"/O1"} else {"/O2"})
                 }
-            val cflags = f"/utf-8 /nologo{opt_flags}{omp_flag} /I{runtime_include_path}"
+            // the linker switches to link-time code generation itself when it meets /GL objects
+            val lto_flag = if Options.opt.lto {" /GL"} else {""}
+            val cflags = f"/utf-8 /nologo{opt_flags}{omp_flag}{lto_flag} /I{runtime_include_path}"
             ("win", "cl", "cl", ".obj", "/c /Fo", "/Fe", "", cflags, "/nologo /F10485760 kernel32.lib advapi32.lib")
         } else {
             // unix or hopefully something more or less compatible with it
@@ -428,8 +926,23 @@ fun run_cc(cmods: C_form.cmodule_t list, ficus_root: string) {
             val cpp_comp = "c++ -std=c++11"
             val common_cflags = "-Wno-unknown-warning-option -Wno-dangling-else -Wno-static-in-inline -Wno-parentheses"
             val ggdb_opt = if opt_level == 0 { " -ggdb" } else { "" }
-            val cflags = f"-O{opt_level}{ggdb_opt} {cflags} {common_cflags} -I{runtime_include_path}"
-            val clibs = (if libpath!="" {f"-L{runtime_lib_path}/{libpath} "} else {""}) + f"-lm {clibs}"
+            // with -flto the object files contain the intermediate representation,
+            // and the actual code generation is done at the link stage
+            val lto_flag = if Options.opt.lto {" -flto"} else {""}
+            // let gcc run the link-time code generation in parallel
+            val lto_link_flag = if Options.opt.lto && os == "linux" {" -flto=auto"} else {lto_flag}
+            // the profile data is stored in/loaded from Options.opt.pgo_dir; when the profile is used,
+            // the functions changed since the profile was collected are optimized without it
+            val pgo_dir = Options.opt.pgo_dir
+            val (pgo_cflags, pgo_clibs) =
+                if Options.opt.pgo_gen {
+                    (f" -fprofile-generate={pgo_dir}", " -fprofile-generate")
+                } else if Options.opt.pgo_use {
+                    (f" -fprofile-use={pgo_dir} -fprofile-correction -Wno-missing-profile -Wno-coverage-mismatch", "")
+                } else { ("", "") }
+            val cflags = f"-O{opt_level}{ggdb_opt}{lto_flag}{pgo_cflags} {cflags} {common_cflags} -I{runtime_include_path}"
+            val clibs = (if libpath!="" {f"-L{runtime_lib_path}/{libpath} "} else {""}) +
+                        f"-lm{lto_link_flag}{pgo_clibs} {clibs}"
             (os, c_comp, cpp_comp, ".o", "-c -o ", "-o ", "-l", cflags, clibs)
         }
 
@@ -441,6 +954,33 @@ fun run_cc(cmods: C_form.cmodule_t list, ficus_root: string) {
     val runtime_pseudo_cmod = C_form.cmodule_t {cmod_name=Ast.noid, cmod_cname=runtime_impl, cmod_ccode=[], cmod_recompile=true,
         cmod_skip=false, cmod_main=false, cmod_pragmas=Ast.pragmas_t {pragma_cpp=false, pragma_clibs=[]}}
     val cmods = runtime_pseudo_cmod :: cmods
+    // the runtime is recompiled only when its sources or the flags change
+    val (runtime_src_hash, _) = hash_c_source(runtime_impl + ".c", [runtime_include_path], [])
+    val runtime_hash = string(hash(f"{runtime_src_hash}|{c_comp} {cflags}"))
+    if Options.opt.pgo_gen { ignore(Sys.mkdir(Options.opt.pgo_dir, 0755)) }
+    if Options.opt.pgo_use { merge_clang_profiles(Options.opt.pgo_dir) }
+    // the object files from the previous build are only reused if they were built with the same flags
+    // (and, if the profile is used, with the same profile)
+    val profile_hash = if Options.opt.pgo_use {profile_signature(Options.opt.pgo_dir)} else {""}
+    val cflags_hash = string(hash(f"{c_comp}|{cpp_comp}|{cflags}|{profile_hash}"))
+    val same_cflags = build_manifest.find_opt("cflags") == Some(cflags_hash)
+    // the instrumented object files and the ones optimized with the profile are not shared
+    val cache_dir = if Options.opt.obj_cache && !Options.opt.pgo_gen && !Options.opt.pgo_use
+                    {obj_cache_dir()} else {""}
+    // the headers included by the C code (e.g. from @ccode blocks) are searched in the same
+    // directories as the C compiler does; the runtime headers are hashed just once
+    val cflags_words = array(cflags.split(' ', allow_empty=false))
+    val incdirs = runtime_include_path :: [for w@i <- cflags_words when w.startswith("-I") {
+        val dir = if w != "-I" {w[2:]} else if i + 1 < size(cflags_words) {cflags_words[i+1]} else {""}
+        Filename.normalize(Filename.getcwd(), dir)
+    }]
+    val (cache_base, runtime_headers) =
+        if cache_dir == "" {("", [])} else {
+            val (headers_hash, runtime_headers) =
+                hash_c_source(Filename.normalize(runtime_include_path, "ficus/ficus.h"), incdirs, [])
+            (f"{cc_version_string(c_comp)}|{cc_version_string(cpp_comp)}|{cflags}|{headers_hash}",
+             runtime_headers)
+        }
     val results = [| @parallel for
         {cmod_cname, cmod_ccode, cmod_skip, cmod_pragmas={pragma_cpp, pragma_clibs}} <- array(cmods) {
         val output_fname = Filename.basename(cmod_cname)
@@ -449,68 +989,106 @@ fun run_cc(cmods: C_form.cmodule_t list, ficus_root: string) {
         val (comp, ext) = if is_cpp { (cpp_comp, ".cpp") } else { (c_comp, ".c") }
         val output_fname = Filename.normalize(build_dir, output_fname)
         val output_fname_c = output_fname + ext
-        val (ok_j, reprocess, status_j) =
-            if cmod_skip { (true, false, "skipped") }
-            else if is_runtime { (true, true, "")}
+        val (ok_j, reprocess, status_j, c_hash) =
+            if cmod_skip { (true, false, "skipped", "") }
+            else if is_runtime {
+                val same_runtime = !Options.opt.force_rebuild &&
+                    build_manifest.find_opt(Filename.basename(runtime_impl) + ".c") == Some(runtime_hash)
+                (true, !same_runtime, if same_runtime {"skipped"} else {""}, runtime_hash)
+            }
             else {
-                val str_new = C_pp.pprint_top_to_string(cmod_ccode)
-                val str_old = if Options.opt.force_rebuild {""} else {
-                    try
-                        File.read_utf8(output_fname_c)
-                    catch {
-                    | IOError | FileOpenError => ""
-                    }
-                }
-                if str_new == str_old {
-                    (ok, false, "skipped")
+                val new_hash = string(C_pp.pprint_top_to_hash(cmod_ccode))
+                val have_c = !Options.opt.force_rebuild && Filename.exists(output_fname_c)
+                val old_hash = build_manifest.find_opt(Filename.basename(output_fname_c))
+                if have_c && old_hash == Some(new_hash) {
+                    (ok, false, "skipped", new_hash)
                 } else {
-                    val well_written =
-                        try {
-                            File.write_utf8(output_fname_c, str_new)
-                            true
-                        }
+                    val str_new = C_pp.pprint_top_to_string(cmod_ccode)
+                    val str_old = if !have_c || old_hash.issome() {""} else {
+                        try
+                            File.read_utf8(output_fname_c)
                         catch {
-                        | IOError | FileOpenError => false
+                        | IOError | FileOpenError => ""
                         }
-                    (well_written, well_written,
-                    if well_written {""} else {clrmsg(MsgRed, f"failed to write {output_fname_c}")})
+                    }
+                    if str_new == str_old {
+                        (ok, false, "skipped", new_hash)
+                    } else {
+                        val well_written =
+                            try {
+                                File.write_utf8(output_fname_c, str_new)
+                                true
+                            }
+                            catch {
+                            | IOError | FileOpenError => false
+                            }
+                        (well_written, well_written,
+                        if well_written {""} else {clrmsg(MsgRed, f"failed to write {output_fname_c}")},
+                        if well_written {new_hash} else {""})
+                    }
                 }
             }
         val c_filename = if is_runtime {runtime_impl + ".c"} else {output_fname_c}
         val obj_filename = output_fname + obj_ext
-        val (ok_j, recompiled, status_j) =
-            if ok_j && (reprocess || !Filename.exists(obj_filename)) {
-                val cmd = f"{comp} {cflags} {obj_opt}{obj_filename} {c_filename}"
-                val result =
-                    if c_comp == "cl" {
-                        val p = File.popen(cmd, "rt")
-                        var lineno = 0
-                        // read and immediately dump the output from cl,
-                        // except for the first line, which is the source file name
-                        while true {
-                            val str = p.readln()
-                            if str == "" { break }
-                            lineno += 1
-                            if lineno > 1 {print(str)}
-                        }
-                        p.pclose_exit_status() == 0
-                    } else {
-                        Sys.command(cmd) == 0
-                    }
-                val status = if result {clrmsg(MsgGreen, "ok")} else {clrmsg(MsgRed, "fail")}
-                (result, true, status)
+        val need_compile = ok_j && (reprocess || !same_cflags || !Filename.exists(obj_filename))
+        // the cache key includes the C code and all the headers it includes
+        val cached_obj = if cache_dir == "" || !need_compile {""} else {
+            val (src_hash, _) = hash_c_source(c_filename, incdirs, runtime_headers)
+            val key = hash(f"{cache_base}|{comp}|{src_hash}")
+            Filename.normalize(cache_dir, string(key) + obj_ext)
+        }
+        val (ok_j, recompiled, status_j, cmd) =
+            if need_compile && cached_obj != "" && Filename.exists(cached_obj) &&
+               copy_file(cached_obj, obj_filename) {
+                ignore(Filename.touch(cached_obj))
+                (true, true, "taken from the cache", "")
+            } else if need_compile {
+                (true, true, "", f"{comp} {cflags} {obj_opt}{obj_filename} {c_filename}")
             } else {
-                (ok_j, false, status_j)
+                (ok_j, false, status_j, "")
             }
-        pr_verbose(f"CC {c_filename}: {status_j}")
+        if cmd == "" { pr_verbose(f"CC {c_filename}: {status_j}") }
         val clibs = [for (l, _) <- pragma_clibs { l }].rev()
-        (is_cpp, recompiled, clibs, ok_j, obj_filename)
+        (is_cpp, recompiled, clibs, ok_j, obj_filename, (Filename.basename(c_filename), c_hash),
+         (c_filename, cmd, cached_obj))
     } |]
 
+    // compile the modules, starting from the ones that took the most time last time,
+    // so that a big module, compiled at the end, does not delay the whole build
+    val jobs = fold jobs = [] for (_, _, _, _, obj, _, (c_filename, cmd, _))@i <- results {
+        if cmd == "" {jobs} else {
+            val est_time = match build_manifest.find_opt(Filename.basename(obj) + ":ms") {
+                | Some(t) => t.to_int_or(0)
+                // a rough estimate for the first build
+                | _ => int(Filename.getsize(c_filename)/100)
+                }
+            (est_time, i, cmd) :: jobs
+        }
+    }
+    val jobs = jobs.sort(fun ((t1, _, _), (t2, _, _)) {t1 > t2})
+    val job_results = run_cc_jobs([for (_, i, cmd) <- jobs {(i, cmd)}], size(results), c_comp == "cl")
+
+    var cache_added = 0L
     val fold (any_cpp, any_recompiled, all_clibs, ok, objs) = (false, false, [], ok, [])
-        for (is_cpp, is_recompiled, clibs_j, ok_j, obj) <- results {
+        for (is_cpp, is_recompiled, clibs_j, ok_j, obj, (c_key, c_hash), (c_filename, cmd, cached_obj))@i <- results {
+            val ok_j = if cmd == "" {ok_j} else {
+                val (result, ms) = job_results[i]
+                if result {
+                    build_manifest.add(Filename.basename(obj) + ":ms", string(ms))
+                    if cached_obj != "" && copy_file(obj, cached_obj) {
+                        cache_added += Filename.getsize(cached_obj)
+                    }
+                }
+                val status = if result {clrmsg(MsgGreen, "ok")} else {clrmsg(MsgRed, "fail")}
+                pr_verbose(f"CC {c_filename}: {status}")
+                result
+            }
+            if c_hash != "" { build_manifest.add(c_key, c_hash) }
             (any_cpp | is_cpp, any_recompiled | is_recompiled, clibs_j + all_clibs, ok & ok_j, obj :: objs)
         }
+    if ok { build_manifest.add("cflags", cflags_hash) }
+    save_build_manifest()
+    if cache_dir != "" { trim_obj_cache(cache_dir, obj_ext, cache_added) }
     if ok && !any_recompiled && Filename.exists(Options.opt.app_filename) {
         pr_verbose(f"{Options.opt.app_filename} is up-to-date\n")
         ok
@@ -528,6 +1106,8 @@ fun run_cc(cmods: C_form.cmodule_t list, ficus_root: string) {
                 " ".join([for l <- all_clibs.rev() {link_lib_opt + l}])
             }
         val clibs = clibs + " " + custom_clibs
+        // the profile collected by the previously built instrumented application is not valid anymore
+        if Options.opt.pgo_gen { clear_profile(Options.opt.pgo_dir) }
         pr_verbose(f"Linking the app with flags={clibs}")
         val cmd = (if any_cpp {cpp_comp} else {c_comp}) + " " + appname_opt + Options.opt.app_filename
         val cmd = cmd + " " + " ".join(objs) + " " + clibs
@@ -556,6 +1136,8 @@ fun print_all_compile_errs()
 
 fun process_all(fname0: string): bool {
     Ast.init_all()
+    all_pass_stats = []
+    Sys.enable_alloc_stat(Options.opt.time_passes)
     try {
         val (ficus_root, ficus_path) = find_ficus_dirs()
         if ficus_root == "" { throw Fail(
@@ -566,7 +1148,7 @@ Please, add the directory 'lib' containing Builtins.fx to
 and there are <ficus_root>/runtime and <ficus_root>/lib.
 2. or 'ficus' executable is in (/usr|/usr/local|/opt|...)/bin and
    there are (/usr|...)/lib/ficus-{__ficus_major__}.{__ficus_minor__}/{{runtime, lib}}") }
-        val ok = parse_all(fname0, ficus_path)
+        val ok = timed_pass("parse", 0, fun () {parse_all(fname0, ficus_path)}, no_ksize)
         if !ok { throw CumulativeParseError }
         val graph = [for minfo <- Ast.all_modules {
                         (minfo.dm_idx, minfo.dm_deps)
@@ -581,7 +1163,7 @@ and there are <ficus_root>/runtime and <ficus_root>/lib.
         val modules_used = ", ".join([for m_idx <- Ast.all_modules_sorted { Ast.pp(Ast.get_module_name(m_idx)) }])
         val parsing_complete = clrmsg(MsgBlue, "Parsing complete")
         pr_verbose(f"{parsing_complete}. Modules used: {modules_used}")
-        val ok = typecheck_all(Ast.all_modules_sorted)
+        val ok = timed_pass("typecheck", 0, fun () {typecheck_all(Ast.all_modules_sorted)}, no_ksize)
         if ok {
             pr_verbose(clrmsg(MsgBlue, "Type checking complete"))
             if Options.opt.print_ast {
@@ -591,25 +1173,36 @@ and there are <ficus_root>/runtime and <ficus_root>/lib.
                 }
             }
         }
-        val (kmods, ok) = if ok { k_normalize_all(Ast.all_modules_sorted) } else { ([], false) }
+        val (kmods, ok) = if ok {
+            timed_pass("K-normalization", 0, fun () {k_normalize_all(Ast.all_modules_sorted)},
+                       fun (r: (kmodule_t list, bool)) {kmods_size(r.0)})
+        } else { ([], false) }
         if ok {
             pr_verbose(clrmsg(MsgBlue, "K-normalization complete"))
             if Options.opt.print_k0 { K_pp.pp_kmods(kmods) }
         }
         val (kmods, ok) = if ok {
             pr_verbose(clrmsg(MsgBlue, "K-form optimization started"))
+            if Options.opt.pgo_use { load_profile(Options.opt.pgo_dir) }
             k_optimize_all(kmods)
         } else { ([], false) }
+        if Options.opt.inline_report { K_inline.print_inline_report() }
         if ok {
             pr_verbose(clrmsg(MsgBlue, "K-form optimization complete"))
             if Options.opt.print_k { K_pp.pp_kmods(kmods) }
         }
-        val ok = if !Options.opt.gen_c { ok } else {
-            val (cmods, ok) = if ok { k2c_all(kmods) } else { ([], false) }
+        val ok = if !Options.opt.gen_c {
+            if ok && Options.opt.time_passes { print_pass_stats() }
+            ok
+        } else {
+            val (cmods, ok) = if ok {
+                timed_pass("K-form to C-form", 0, fun () {k2c_all(kmods)}, no_ksize)
+            } else { ([], false) }
             val ok =
                 if ok && (Options.opt.make_app || Options.opt.run_app) {
-                    run_cc(cmods, ficus_root)
+                    timed_pass("C compilation & linking", 0, fun () {run_cc(cmods, ficus_root)}, no_ksize)
                 } else { ok }
+            if ok && Options.opt.time_passes { print_pass_stats() }
             val ok = if ok && Options.opt.run_app { run_app() } else { ok }
             ok
         }
@@ -627,3 +1220,43 @@ and there are <ficus_root>/runtime and <ficus_root>/lib.
         false
     }
 }
+
+val WATCH_INTERVAL_MS = 300
+// the main file should be missing for so many polls in a row to stop the watch mode,
+// because some editors save files by deleting or renaming the old version first
+val WATCH_STOP_POLLS = 10
+
+// Builds the application, waits for changes in the source files of the application
+// and all the imported modules, then builds it again, and so on, until the main source file
+// is removed. Returns the result of the last build.
+// The compiler state is reset before each build, but the unchanged files
+// are not tokenized again (see Parser.parse()) and the unchanged modules
+// are not recompiled (see k_skip_some()).
+fun watch_all(fname0: string): bool
+{
+    val fname0 = Filename.normalize(Filename.getcwd(), fname0)
+    var ok = false
+    var nmissing = 0
+    while nmissing < WATCH_STOP_POLLS {
+        ok = process_all(fname0)
+        val files = fold files = fname0 :: [] for {dm_filename, dm_real} <- Ast.all_modules {
+            if dm_real && dm_filename != fname0 {dm_filename :: files} else {files}
+        }
+        val mtimes = [for f <- files {Filename.getmtime(f)}]
+        println(f"Watching {files.length()} files for changes. Remove {fname0} or press Ctrl-C to stop ...")
+        File.stdout.flush()
+        var changed = false
+        while !changed && nmissing < WATCH_STOP_POLLS {
+            Sys.sleep(WATCH_INTERVAL_MS)
+            if !Filename.exists(fname0) {
+                nmissing += 1
+            } else {
+                nmissing = 0
+                changed = [for f <- files {Filename.getmtime(f)}] != mtimes
+            }
+        }
+        // let the editor finish writing the file(s)
+        if changed { Sys.sleep(WATCH_INTERVAL_MS) }
+    }
+    ok
+}
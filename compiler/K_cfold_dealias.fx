@@ -21,12 +21,15 @@
       respectively, everywhere in the code. With a important exception:
       when a global user-defined value is assigned a temporary value,
       this temporary value may be eliminated, but not the user-defined value.
+      Another exception: a global value is substituted in the other modules only if
+      it's defined as a literal or an alias from the very beginning (see find_exported_consts()),
+      otherwise the substitution is done only inside its module and the definition is kept.
 */
 
 from Ast import *
 from K_form import *
 import K_pp
-import Math, Hashmap
+import Math, Hashmap, Hashset
 
 type aclass_t =
     | ConstZero
@@ -303,9 +306,49 @@ fun print_subst_map(m: idamap_t, loc: loc_t) {
     println("}")
 }
 
+/*
+   The global values that are defined as literals or aliases of other such values
+   before the optimization starts. Their initializers are a part of the module interface
+   (see Compiler.kmodule_interface()), so that when they change, the dependent modules are
+   recompiled. Other global values may become constants only after some optimizations
+   (e.g. inline expansion of a function call), which are not reflected in the interface,
+   so they are not propagated to the other modules.
+*/
+var exported_consts: id_hashset_t = empty_id_hashset(1)
+
+fun find_exported_consts_all(kmods: kmodule_t list)
+{
+    exported_consts = empty_id_hashset(256)
+    for km <- kmods {
+        for e <- km.km_top {
+            | KDefVal (n, KExpAtom (a, (_, loc)), _) =>
+                val {kv_flags} = get_kval(n, loc)
+                if kv_flags.val_flag_global != [] && !kv_flags.val_flag_mutable {
+                    match a {
+                    | AtomLit _ => exported_consts.add(n)
+                    | AtomId n2 =>
+                        /* the values from other modules are only propagated if they are exported too;
+                           the aliases of functions are always replaced with the functions,
+                           because such aliases cannot be defined as the global values in C */
+                        val exported = match kinfo_(n2, loc) {
+                            | KVal _ => n2.m != km.km_idx || exported_consts.mem(n2)
+                            | _ => true
+                            }
+                        if exported { exported_consts.add(n) }
+                    }
+                }
+            | _ => {}
+        }
+    }
+    kmods
+}
+
 fun cfold_dealias(kmods: kmodule_t list)
 {
     var ida_map: idamap_t = Hashmap.empty(1024, noid, AtomId(noid))
+    // the substitutions that should only be done in the module, where the value is defined
+    val module_local = empty_id_hashset(256)
+    var curr_m = 0
     var concat_map: idalmap_t = Hashmap.empty(1024, noid, [])
     var mktup_map: idalmap_t = Hashmap.empty(1024, noid, [])
 
@@ -313,7 +356,7 @@ fun cfold_dealias(kmods: kmodule_t list)
         match a {
         | AtomId n =>
             match ida_map.find_opt(n) {
-            | Some a2 => a2
+            | Some a2 when n.m == curr_m || !module_local.mem(n) => a2
             | _ => a
             }
         | _ => a
@@ -333,6 +376,13 @@ fun cfold_dealias(kmods: kmodule_t list)
                     | _ => n
                     }
             val e = KDefVal(n, rhs_e, loc)
+            val is_global_n = kv_flags.val_flag_global != []
+            // replaces 'n' with 'a' and removes the definition, if possible
+            fun subst_val(a: atom_t) {
+                ida_map.add(n, a)
+                if is_global_n && !exported_consts.mem(n) { module_local.add(n); e }
+                else { KExpNop(loc) }
+            }
             if !is_mutable(n, loc) {
                 match rhs_e {
                 | KExpAtom (a, (_, loc2)) =>
@@ -342,7 +392,6 @@ fun cfold_dealias(kmods: kmodule_t list)
                             must be immutable, otherwise the change may affect the semantics
                         */
                         if !is_mutable(n2, loc2) {
-                            val is_global_n = kv_flags.val_flag_global != []
                             val is_global_n2 = match get_idk_scope(n2, loc2) {
                                     | ScModule _ :: _ => true
                                     | _ => false
@@ -354,13 +403,12 @@ fun cfold_dealias(kmods: kmodule_t list)
                                cause problems with separate compilation of .c sources, when
                                the temporary value suddenly needs to be accessed from another module. */
                             | (true, false) => e
-                            | _ => ida_map.add(n, AtomId(n2)); KExpNop(loc)
+                            | _ => subst_val(a)
                             }
                         } else { e }
-                    | AtomLit (KLitNil (KTypList _)) => ida_map.add(n, a); KExpNop(loc)
+                    | AtomLit (KLitNil (KTypList _)) => subst_val(a)
                     | AtomLit (KLitNil _) => e
-                    | AtomLit c =>
-                        ida_map.add(n, a); KExpNop(loc)
+                    | AtomLit c => subst_val(a)
                     }
                 | KExpIntrin (IntrinStrConcat, al, (_, loc)) when
                         kv_flags.val_flag_temp && all(for a <- al {!is_mutable_atom(a, loc)}) =>
@@ -558,7 +606,8 @@ fun cfold_dealias(kmods: kmodule_t list)
         kcb_kexp=Some(cfd_kexp_)
     }
     [for km <- kmods {
-        val {km_top=top_code} = km
+        val {km_idx, km_top=top_code} = km
+        curr_m = km_idx
         val top_code = [for e <- top_code { cfd_kexp_(e, cfd_callb) } ]
         val top_code = [for e <- top_code { cfd_kexp_(e, cfd_callb) } ]
         km.{km_top=top_code}
@@ -0,0 +1,110 @@
+/*
+    This file is a part of ficus language project.
+    See ficus/LICENSE for the licensing terms
+*/
+
+/*
+    Moves compilation of constant regular expressions out of functions and loops.
+
+    Re.compile(<string literal>) parses the pattern and builds the bytecode
+    each time it's called. If the call is made inside a function or a loop,
+    e.g. in a function that parses a single line of a log file,
+    the regexp is compiled again and again for every line.
+
+    Regexps are immutable (the matcher state is kept outside of Re.t),
+    so the call can be replaced with a module-level value,
+    initialized once, when the module is initialized:
+
+    fun parse_line(s: string) = Re.compile(r"ERROR (\d+)").find(s)
+    =>
+    val re@123 = Re.compile(r"ERROR (\d+)")
+    fun parse_line(s: string) = re@123.find(s)
+
+    The pattern is compiled by the compiler itself first. If it's invalid,
+    the call is left as-is, so that the exception is thrown at runtime,
+    in the same place as before (the invalid pattern may be used on purpose,
+    e.g. in a test, so there is no warning). The calls inside 'try' blocks
+    are not touched either, since the exceptions from there are expected to be handled.
+
+    Note that the hoisted patterns are compiled at module initialization,
+    even if the functions that use them are never called.
+
+    Note that this pass does not specialize the matching itself:
+    no C code is generated for a particular pattern. The hoisted pattern
+    is still compiled to the bytecode once, at module initialization,
+    and the bytecode is executed by the generic engine (regex.impl.h),
+    which uses the lazy DFA and the literal prefilter where possible.
+*/
+
+from Ast import *
+from K_form import *
+import Re
+
+fun is_re_compile(f: id_t, loc: loc_t) =
+    match kinfo_(f, loc) {
+    | KFun (ref {kf_name, kf_scope=ScModule(m) :: _}) =>
+        pp(kf_name) == "compile" && pp(get_module_name(m)) == "Re"
+    | _ => false
+    }
+
+fun is_valid_regex(rstr: string) =
+    try {
+        ignore(Re.compile(rstr))
+        true
+    } catch {
+    | _ => false
+    }
+
+fun hoist_const_regex(km: kmodule_t)
+{
+    val {km_idx, km_top} = km
+    var hoisted: (string, id_t) list = []
+    var new_defs: kcode_t = []
+    var try_depth = 0
+
+    fun hoist_atom_(a: atom_t, loc: loc_t, callb: k_callb_t) = a
+    fun hoist_ktyp_(t: ktyp_t, loc: loc_t, callb: k_callb_t) = t
+    fun hoist_kexp_(e: kexp_t, callb: k_callb_t) =
+        match e {
+        | KExpTryCatch(e1, e2, ctx) =>
+            try_depth += 1
+            val e1 = hoist_kexp_(e1, callb)
+            try_depth -= 1
+            KExpTryCatch(e1, hoist_kexp_(e2, callb), ctx)
+        | KExpCall(f, AtomLit(KLitString(rstr)) :: [], (t, loc))
+            when try_depth == 0 && is_re_compile(f, loc) =>
+            match hoisted.assoc_opt(rstr) {
+            | Some(n) => KExpAtom(AtomId(n), (t, loc))
+            | _ =>
+                if !is_valid_regex(rstr) {
+                    e
+                } else {
+                    val n = gen_idk(km_idx, "regex")
+                    val flags = default_val_flags().{val_flag_private=true,
+                                                     val_flag_global=ScModule(km_idx) :: []}
+                    new_defs = create_kdefval(n, t, flags, Some(e), new_defs, loc)
+                    hoisted = (rstr, n) :: hoisted
+                    KExpAtom(AtomId(n), (t, loc))
+                }
+            }
+        | _ => walk_kexp(e, callb)
+        }
+
+    val hoist_callb = k_callb_t
+    {
+        kcb_atom=Some(hoist_atom_),
+        kcb_ktyp=Some(hoist_ktyp_),
+        kcb_kexp=Some(hoist_kexp_)
+    }
+    val new_top = [for e <- km_top {
+        match e {
+        // the top-level values are computed just once anyway
+        | KDefVal(_, KExpCall _, _) => e
+        | _ => hoist_kexp_(e, hoist_callb)
+        }
+    }]
+    km.{km_top=new_defs.rev() + new_top}
+}
+
+fun hoist_const_regex_all(kmods: kmodule_t list) =
+    [for km <- kmods { hoist_const_regex(km) }]
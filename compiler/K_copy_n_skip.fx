@@ -139,15 +139,97 @@
     function. Same approach is used here. As a bonus, we not only make
     the incremental compilation not only more robust, we allow the inline
     function expansion step to be run in parallel on different modules.
+
+    In the same way we copy small non-generic functions (e.g. tiny helpers from
+    Builtins, Char or String), so that their calls from other modules can be expanded
+    as well. A function is 'exported' this way if it's not larger than 1/4 of
+    the inline expansion threshold, it's not recursive, does not contain
+    other functions, C code or 'return' statements and does not access any private
+    values/functions of its module (except for other exported functions),
+    since those are not accessible from other modules.
+    The copies that were not expanded are treated as any other copied
+    functions, i.e. they are removed if unused or else compiled as a part of
+    the destination module. The bodies of exported functions are
+    a part of the module interface (see Compiler.kmodule_interface()),
+    so when such a body changes, the modules that use the function are re-processed.
 */
 
 from Ast import *
 from K_form import *
-import K_inline, K_pp
+import K_inline, K_pp, Options
 import Map, Set, Hashmap, Hashset
 
 type subst_map_t = (id_t, id_t) Hashmap.t
 
+// small non-generic functions that are copied to the other modules (see the comment above)
+var exported_funcs = empty_id_hashset(1)
+
+fun find_exported_funcs(kmods: kmodule_t list): void
+{
+    exported_funcs = empty_id_hashset(256)
+    // with -O0 the inline expansion is effectively disabled
+    val max_size = if Options.opt.optimize_level > 0 {Options.opt.inline_thresh / 4} else {0}
+    fun has_bad_exps(e: kexp_t)
+    {
+        var bad = false
+        fun fold_bad_ktyp_(t: ktyp_t, loc: loc_t, callb: k_fold_callb_t) {}
+        fun fold_bad_kexp_(e: kexp_t, callb: k_fold_callb_t) =
+            match e {
+            | KDefFun _ | KExpReturn _ | KExpCCode _ => bad = true
+            | _ => if !bad { fold_kexp(e, callb) }
+            }
+        val bad_callb = k_fold_callb_t {
+            kcb_fold_atom=None,
+            kcb_fold_ktyp=Some(fold_bad_ktyp_),
+            kcb_fold_kexp=Some(fold_bad_kexp_)
+        }
+        fold_kexp(e, bad_callb)
+        bad
+    }
+    fun is_private(i: id_t, loc: loc_t) =
+        match kinfo_(i, loc) {
+        | KFun (ref {kf_flags}) => kf_flags.fun_flag_private
+        | KVal {kv_flags} => is_val_global(kv_flags) && kv_flags.val_flag_private
+        | _ => false
+        }
+    if max_size > 0 {
+        val _ = K_inline.find_recursive_funcs_all(kmods)
+        for {km_idx, km_top, km_main} <- kmods {
+            val candidates = empty_id_hashset(64)
+            if !km_main {
+                for e <- km_top {
+                    | KDefFun (ref {kf_name, kf_body, kf_flags})
+                        when !kf_flags.fun_flag_recursive && !kf_flags.fun_flag_ccode &&
+                             !kf_flags.fun_flag_instance && !kf_flags.fun_flag_inline &&
+                             kf_flags.fun_flag_ctor == CtorNone &&
+                             kf_flags.fun_flag_method_of == noid =>
+                        if K_inline.calc_exp_size(kf_body) <= max_size && !has_bad_exps(kf_body) {
+                            candidates.add(kf_name)
+                        }
+                    | _ => {}
+                }
+            }
+            // exclude the functions that (directly or via other candidates)
+            // access private values/functions of the module
+            var changed = !candidates.empty()
+            while changed {
+                changed = false
+                for e <- km_top {
+                    | KDefFun (ref {kf_name, kf_loc}) when candidates.mem(kf_name) =>
+                        val uses_private = used_by(e :: [], 16).exists(fun (i) {
+                            i.m == km_idx && i != kf_name && !candidates.mem(i) && is_private(i, kf_loc)})
+                        if uses_private {
+                            candidates.remove(kf_name)
+                            changed = true
+                        }
+                    | _ => {}
+                }
+            }
+            exported_funcs.union(candidates)
+        }
+    }
+}
+
 fun copy_some(kmods: kmodule_t list)
 {
     val toposort_idx = array(size(all_modules), 123456789)
@@ -156,19 +238,21 @@ fun copy_some(kmods: kmodule_t list)
     }
 
     // step 1. Scan all the modules, collect instances of
-    // generic types and functions, as well as inline functions.
+    // generic types and functions, as well as inline and exported functions.
     // Note that we only need data types and functions accessible from
     // other modules, so we need to scan only the top level of each module.
     // The index is used for the further sorting to put
     // the copied functionality in more or less stable order, which
     // is similar to the order of defined functionality.
+    find_exported_funcs(kmods)
     var all_copied: (id_t, (int, kexp_t)) list = []
     var idx = 0
     for km <- kmods {
         val {km_top} = km
         for e <- km_top {
             | KDefFun (ref {kf_name, kf_flags})
-                when kf_flags.fun_flag_instance || kf_flags.fun_flag_inline =>
+                when kf_flags.fun_flag_instance || kf_flags.fun_flag_inline ||
+                     exported_funcs.mem(kf_name) =>
                 all_copied = (kf_name, (idx, e)) :: all_copied
                 idx += 1
             | KDefTyp (ref {kt_name, kt_targs}) =>
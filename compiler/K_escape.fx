@@ -0,0 +1,263 @@
+/*
+    This file is a part of ficus language project.
+    See ficus/LICENSE for the licensing terms
+*/
+
+/*
+    Escape analysis for closures and references.
+
+    Normally each closure (KExpMkClosure) and each reference ('ref x', including the references
+    created by K_freevars for the mutable variables captured by closures) is allocated in the heap
+    and is reference-counted. However, most of such values, e.g. the lambda functions passed to
+    Array.sort(), List.map(), Hashmap.app() etc., never outlive the block where they are created.
+    We find such values, so that C_gen_code could put them on stack.
+
+    A value 'v' does not escape if every its use is one of the following:
+    * a call of 'v' (closure) or the dereferencing '*v' (reference);
+    * passing 'v' as a parameter of a function of the same module,
+      where this parameter does not escape either;
+    * capturing 'v' by a closure that does not escape,
+      provided that the copy of 'v' inside the closure body does not escape;
+    * storing 'v' into a reference that does not escape.
+    Everything else (storing 'v' into a data structure or a variable, returning or throwing it,
+    passing it to an indirect call or to a function of another module etc.) makes 'v' escape.
+    The analysis is optimistic: we start with the assumption that nothing escapes and then
+    propagate the 'escape' property until we reach the fixed point, so recursive functions
+    that just pass their functional parameters down are handled properly.
+
+    Non-recursive variants are stored by value anyway. The cells of recursive variants
+    are not considered, because they are normally linked into the recursive data structures.
+*/
+
+from Ast import *
+from K_form import *
+import Options
+import Hashmap, Hashset
+
+// the closures and references that can be put on stack
+var stack_vals: id_hashset_t = empty_id_hashset(1)
+
+fun is_stack_candidate_typ(t: ktyp_t, loc: loc_t) =
+    match deref_ktyp(t, loc) {
+    | KTypFun _ | KTypRef _ => true
+    | _ => false
+    }
+
+// checks whether the function body may let the closure data escape or use it in an unknown way
+fun uses_fcv_or_ccode(e: kexp_t)
+{
+    var found = false
+    fun fold_fcv_ktyp_(t: ktyp_t, loc: loc_t, callb: k_fold_callb_t) {}
+    fun fold_fcv_kexp_(e: kexp_t, callb: k_fold_callb_t) =
+        match e {
+        | KExpIntrin (IntrinMakeFPbyFCV, _, _) | KExpCCode _ => found = true
+        | _ => if !found { fold_kexp(e, callb) }
+        }
+    val fcv_callb = k_fold_callb_t {
+        kcb_fold_atom=None,
+        kcb_fold_ktyp=Some(fold_fcv_ktyp_),
+        kcb_fold_kexp=Some(fold_fcv_kexp_)
+    }
+    fold_fcv_kexp_(e, fcv_callb)
+    found
+}
+
+fun find_stack_vals(top_code: kcode_t)
+{
+    /* all the values we track: the closures and references created in the module,
+       the functional and reference parameters of the module functions, the copies
+       of the captured values inside the closure bodies and the local values/variables
+       of the same types that may hold the aliases of the tracked values */
+    val candidates = empty_id_hashset(256)
+    // the closures and references that we may put on stack
+    val local_vals = empty_id_hashset(256)
+    // the order of definitions; the parameters are defined before the function body
+    val def_order: (id_t, int) Hashmap.t = Hashmap.empty(256, noid, 0)
+    val nuses: (id_t, int) Hashmap.t = Hashmap.empty(256, noid, 0)
+    val nallowed: (id_t, int) Hashmap.t = Hashmap.empty(256, noid, 0)
+    // 'w => [v1, v2, ...]' means that if w escapes, v1, v2, ... escape as well
+    val escapes_with: (id_t, id_t list) Hashmap.t = Hashmap.empty(256, noid, [])
+    // 'v => [u1, u2, ...]' means that 'v' is copied to the local values/variables u1, u2, ...
+    val aliases: (id_t, id_t list) Hashmap.t = Hashmap.empty(256, noid, [])
+    // the module functions with the analyzable bodies
+    val top_funcs = empty_id_hashset(256)
+    // the closure data argument => [(idx, copy of the captured value), ...]
+    val fcv_copies: (id_t, (int, id_t) list) Hashmap.t = Hashmap.empty(64, noid, [])
+
+    fun inc_count(m: (id_t, int) Hashmap.t, i: id_t) {
+        val idx = m.find_idx_or_insert(i)
+        m.table[idx].data += 1
+    }
+    fun add_to_list(m: (id_t, id_t list) Hashmap.t, k: id_t, v: id_t) {
+        val idx = m.find_idx_or_insert(k)
+        m.table[idx].data = v :: m.table[idx].data
+    }
+    fun allow_use(v: id_t) = inc_count(nallowed, v)
+    fun add_candidate(v: id_t) {
+        candidates.add(v)
+        def_order.add(v, def_order.size())
+    }
+    // 'v' may be safely used, as long as 'w' does not escape
+    fun allow_use_via(v: id_t, w: id_t) {
+        allow_use(v)
+        add_to_list(escapes_with, w, v)
+    }
+
+    for e <- top_code {
+        | KDefFun (ref {kf_name, kf_body, kf_flags}) =>
+            if !kf_flags.fun_flag_ccode && kf_flags.fun_flag_ctor == CtorNone && !uses_fcv_or_ccode(kf_body) {
+                top_funcs.add(kf_name)
+            }
+        | _ => {}
+    }
+
+    // the first pass: find all the candidates
+    fun collect_ktyp_(t: ktyp_t, loc: loc_t, callb: k_fold_callb_t) {}
+    fun collect_kexp_(e: kexp_t, callb: k_fold_callb_t) =
+        match e {
+        | KDefFun (ref {kf_name, kf_params, kf_closure={kci_arg}, kf_loc}) =>
+            if top_funcs.mem(kf_name) {
+                if kci_arg != noid { fcv_copies.add(kci_arg, []) }
+                for p <- kf_params {
+                    if is_stack_candidate_typ(get_idk_ktyp(p, kf_loc), kf_loc) { add_candidate(p) }
+                }
+            }
+            fold_kexp(e, callb)
+        | KDefVal (v, rhs, loc) =>
+            val {kv_typ, kv_flags} = get_kval(v, loc)
+            if is_stack_candidate_typ(kv_typ, loc) && !is_val_global(kv_flags) {
+                add_candidate(v)
+                match rhs {
+                | KExpMkClosure (make_fp, f, _, _) when make_fp != noid && top_funcs.mem(f) &&
+                                                        !kv_flags.val_flag_mutable =>
+                    local_vals.add(v)
+                | KExpUnary (OpMkRef, _, _) when !kv_flags.val_flag_mutable =>
+                    local_vals.add(v)
+                | KExpMem (k, idx, _) when fcv_copies.mem(k) =>
+                    val idx_k = fcv_copies.find_idx_or_insert(k)
+                    fcv_copies.table[idx_k].data = (idx, v) :: fcv_copies.table[idx_k].data
+                | _ => {}
+                }
+            }
+            fold_kexp(e, callb)
+        | _ => fold_kexp(e, callb)
+        }
+    val collect_callb = k_fold_callb_t {
+        kcb_fold_atom=None,
+        kcb_fold_ktyp=Some(collect_ktyp_),
+        kcb_fold_kexp=Some(collect_kexp_)
+    }
+    for e <- top_code { collect_kexp_(e, collect_callb) }
+
+    // the second pass: count all the uses of the candidates and the "safe" uses
+    fun count_atom_(a: atom_t, loc: loc_t, callb: k_fold_callb_t) =
+        match a {
+        | AtomId i when candidates.mem(i) => inc_count(nuses, i)
+        | _ => {}
+        }
+    fun count_ktyp_(t: ktyp_t, loc: loc_t, callb: k_fold_callb_t) {}
+    fun count_kexp_(e: kexp_t, callb: k_fold_callb_t) =
+        match e {
+        | KDefVal (v, KExpMkClosure (_, f, args, _), loc) when local_vals.mem(v) =>
+            val copies = match kinfo_(f, loc) {
+                         | KFun (ref {kf_closure={kci_arg}}) => fcv_copies.find_opt(kci_arg).value_or([])
+                         | _ => []
+                         }
+            for a@idx <- args {
+                match a {
+                | AtomId i when candidates.mem(i) =>
+                    allow_use_via(i, v)
+                    for (j, c) <- copies { if j == idx { add_to_list(escapes_with, c, i) } }
+                | _ => {}
+                }
+            }
+            fold_kexp(e, callb)
+        | KDefVal (v, KExpUnary (OpMkRef, AtomId i, _), _) when local_vals.mem(v) && candidates.mem(i) =>
+            allow_use_via(i, v)
+            fold_kexp(e, callb)
+        | KDefVal (u, KExpAtom (AtomId v, _), _) when candidates.mem(u) && candidates.mem(v) =>
+            allow_use_via(v, u)
+            add_to_list(aliases, v, u)
+            fold_kexp(e, callb)
+        | KExpAssign (u, rv, _) when candidates.mem(u) =>
+            allow_use(u)
+            match rv {
+            | AtomId v when candidates.mem(v) =>
+                allow_use_via(v, u)
+                add_to_list(aliases, v, u)
+            | _ => {}
+            }
+            fold_kexp(e, callb)
+        | KExpCall (f, args, (_, loc)) =>
+            if candidates.mem(f) { allow_use(f) }
+            val params = match kinfo_(f, loc) {
+                         | KFun (ref {kf_params}) when top_funcs.mem(f) => kf_params
+                         | _ => []
+                         }
+            if params.length() == args.length() {
+                for a <- args, p <- params {
+                    match a {
+                    | AtomId i when candidates.mem(i) && candidates.mem(p) => allow_use_via(i, p)
+                    | _ => {}
+                    }
+                }
+            }
+            fold_kexp(e, callb)
+        | KExpUnary (OpDeref, AtomId r, _) =>
+            if candidates.mem(r) { allow_use(r) }
+            fold_kexp(e, callb)
+        // the original free variables, listed in the closure data definition, are not the actual uses
+        | KDefClosureVars _ => {}
+        | _ => fold_kexp(e, callb)
+        }
+    val count_callb = k_fold_callb_t {
+        kcb_fold_atom=Some(count_atom_),
+        kcb_fold_ktyp=Some(count_ktyp_),
+        kcb_fold_kexp=Some(count_kexp_)
+    }
+    for e <- top_code { count_kexp_(e, count_callb) }
+
+    // each candidate is mentioned once in its definition
+    var worklist = [for v <- candidates.list()
+                    when nuses.find_opt(v).value_or(0) - 1 != nallowed.find_opt(v).value_or(0) {v}]
+    /* a stack-allocated value may only be copied to the values/variables defined after it
+       (i.e. within its scope), otherwise it may be used after the end of its block */
+    fun outlived_by_alias(v: id_t, visited: id_hashset_t, v0_order: int): bool
+    {
+        var outlived = false
+        for u <- aliases.find_opt(v).value_or([]) {
+            if !outlived && !visited.mem(u) {
+                visited.add(u)
+                outlived = def_order.find_opt(u).value_or(0) < v0_order ||
+                           outlived_by_alias(u, visited, v0_order)
+            }
+        }
+        outlived
+    }
+    local_vals.app(fun (v) {
+        if outlived_by_alias(v, empty_id_hashset(8), def_order.find_opt(v).value_or(0)) {
+            worklist = v :: worklist
+        }})
+    val escaped = empty_id_hashset(256)
+    for v <- worklist { escaped.add(v) }
+    while worklist != [] {
+        val w = worklist.hd()
+        worklist = worklist.tl()
+        for v <- escapes_with.find_opt(w).value_or([]) {
+            if !escaped.mem(v) {
+                escaped.add(v)
+                worklist = v :: worklist
+            }
+        }
+    }
+    local_vals.app(fun (v) {if !escaped.mem(v) {stack_vals.add(v)}})
+}
+
+fun find_stack_vals_all(kmods: kmodule_t list)
+{
+    stack_vals = empty_id_hashset(1024)
+    if Options.opt.optimize_level > 0 {
+        for km <- kmods { find_stack_vals(km.km_top) }
+    }
+    kmods
+}
@@ -264,8 +264,10 @@ fun new_idk_idx(m_idx: int): int {
     if freeze_idks {
         throw Fail("internal error: new idk is requested when they are frozen")
     }
-    val new_idx = all_modules[m_idx].dm_table.push()
-    val new_kidx = all_idks[m_idx].push()
+    lock_id_tables()
+    val new_idx = push_table_entry(all_modules[m_idx].dm_table)
+    val new_kidx = push_table_entry(all_idks[m_idx])
+    unlock_id_tables()
     if new_idx != new_kidx {
         throw Fail("internal error: unsynchronized outputs from new_id_idx() and new_idk_idx()")
     }
@@ -276,7 +278,7 @@ fun kinfo_(n: id_t, loc: loc_t) =
     if n.m == 0 {KNone}
     else {
         val (m, j) = id2idx_(n, loc)
-        all_idks[m].data[j]
+        table_entry(all_idks[m], j)
     }
 
 fun dup_idk(m_idx: int, old_id: id_t): id_t
@@ -296,7 +298,7 @@ fun set_idk_entry(n: id_t, info: kinfo_t): void
 {
     //val loc = get_kinfo_loc(info)
     val (m, j) = id2idx_(n, noloc)
-    all_idks[m].data[j] = info
+    set_table_entry(all_idks[m], j, info)
 }
 
 fun init_all_idks(): void
@@ -1082,6 +1084,25 @@ fun fold_kexp(e: kexp_t, callb: k_fold_callb_t): void
     }
 }
 
+// Counts the number of K-form expressions (including the nested ones) in the code;
+// used to track how the size of the code changes after each optimization pass
+fun count_kexps(code: kcode_t): int
+{
+    var count = 0
+    fun count_ktyp_(t: ktyp_t, loc: loc_t, callb: k_fold_callb_t) {}
+    fun count_kexp_(e: kexp_t, callb: k_fold_callb_t) {
+        count += 1
+        fold_kexp(e, callb)
+    }
+    val count_callb = k_fold_callb_t {
+        kcb_fold_atom=None,
+        kcb_fold_ktyp=Some(count_ktyp_),
+        kcb_fold_kexp=Some(count_kexp_)
+    }
+    for e <- code { count_kexp_(e, count_callb) }
+    count
+}
+
 fun used_by(code: kcode_t, size0: int): id_hashset_t
 {
     val all_used: id_hashset_t = Hashset.empty(size0, noid)
@@ -21,6 +21,14 @@
        thresholds, we do the inline expansion. If a function is declared as inline, we
        try it expand calls to this function before trying to expand calls from this function.
        Otherwise we can do the opposite thing.
+    4. the thresholds are adjusted for each call site. The calls inside loop bodies
+       may expand bigger functions, depending on the loop nesting depth,
+       and the calls inside the innermost loops get the biggest budget.
+       The caller growth limit does not depend on the loop nesting.
+       If the execution profile is given (see -pgo-use), the budget is also increased
+       for the calls from the hot functions and decreased for the calls from
+       the functions that have never been called. With -inline-report the decision
+       for each call site is printed.
 */
 
 from Ast import *
@@ -37,11 +45,56 @@ type func_info_t =
     fi_nrefs: int;
     fi_flags: fun_flags_t;
     fi_km_idx: int;
+    fi_count: int;
 }
 
 type subst_map_t = (id_t, atom_t) Hashmap.t
 type fir_map_t = (id_t, func_info_t ref) Hashmap.t
 
+/* The function call counts collected by the instrumented application (see -pgo-gen option).
+   The keys are '<module>.<function>:<line>' (see profile_key()). When the profile is given,
+   the calls from the hot functions are expanded more aggressively,
+   and the calls from the functions that have never been called are expanded only
+   if the called functions are very small */
+var profile: (string, int) Hashmap.t = Hashmap.empty(8, "", 0)
+var profile_max = 0
+
+fun profile_key(f: id_t, loc: loc_t) = f"{pp(get_module_name(loc.m_idx))}.{pp(f)}:{loc.line0}"
+
+/* The inline expansion decisions collected for -inline-report.
+   The key is '<call location> <called function>', so the decision made
+   at the later optimization pass replaces the earlier one */
+var inline_decisions: (string, (loc_t, string)) Hashmap.t = Hashmap.empty(8, "", (noloc, ""))
+
+fun print_inline_report()
+{
+    val decisions = inline_decisions.foldl(fun (_, d, decisions) {d :: decisions}, [])
+    val decisions = decisions.sort(fun ((loc1, msg1), (loc2, msg2)) {
+        (loc1.m_idx, loc1.line0, loc1.col0, msg1) < (loc2.m_idx, loc2.line0, loc2.col0, msg2)})
+    for (loc, msg) <- decisions { println(f"{loc}: {msg}") }
+    inline_decisions = Hashmap.empty(8, "", (noloc, ""))
+}
+
+// checks whether there are loops inside the expression (not counting the nested functions)
+fun has_loops(e: kexp_t)
+{
+    var found = false
+    fun fold_loops_ktyp_(t: ktyp_t, loc: loc_t, callb: k_fold_callb_t) {}
+    fun fold_loops_kexp_(e: kexp_t, callb: k_fold_callb_t) =
+        match e {
+        | KExpFor _ | KExpMap _ | KExpWhile _ | KExpDoWhile _ => found = true
+        | KDefFun _ => {}
+        | _ => if !found { fold_kexp(e, callb) }
+        }
+    val loops_callb = k_fold_callb_t {
+        kcb_fold_atom=None,
+        kcb_fold_ktyp=Some(fold_loops_ktyp_),
+        kcb_fold_kexp=Some(fold_loops_kexp_)
+    }
+    fold_kexp(e, loops_callb)
+    found
+}
+
 fun find_recursive_funcs(km_idx: int, top_code: kcode_t): kcode_t
 {
     val idset0 = empty_id_hashset(1)
@@ -379,12 +432,15 @@ fun inline_some(kmods: kmodule_t list)
             fi_size=0,
             fi_nrefs=nrefs,
             fi_flags=default_fun_flags(),
-            fi_km_idx=curr_km_idx
+            fi_km_idx=curr_km_idx,
+            fi_count=-1
         })
     var all_funcs_info: fir_map_t = Hashmap.empty(1024, noid, gen_default_func_info(-1))
 
     var curr_fi = gen_default_func_info(0)
     var curr_km_main = false
+    var curr_loop_depth = 0
+    var curr_innermost = false
 
     fun fold_finfo_atom_(a: atom_t, loc: loc_t, callb: k_fold_callb_t) =
         match a {
@@ -420,7 +476,10 @@ fun inline_some(kmods: kmodule_t list)
                 r_fi = gen_default_func_info(0)
                 all_funcs_info.table[idx].data = r_fi
             }
-            *r_fi = r_fi->{fi_name=kf_name, fi_can_inline=can_inline, fi_size=fsize, fi_flags=kf_flags}
+            val count = if profile.empty() {-1}
+                        else {profile.find_opt(profile_key(kf_name, kf_loc)).value_or(-1)}
+            *r_fi = r_fi->{fi_name=kf_name, fi_can_inline=can_inline, fi_size=fsize,
+                           fi_flags=kf_flags, fi_count=count}
             curr_fi = r_fi
             fold_kexp(e, callb)
             curr_fi = saved_fi
@@ -440,6 +499,18 @@ fun inline_some(kmods: kmodule_t list)
 
     /* step 2. try to actually expand some calls */
     fun inline_ktyp_(t: ktyp_t, loc: loc_t, callb: k_callb_t) = t
+    fun inline_loop_body_(body: kexp_t, callb: k_callb_t) {
+        val saved_innermost = curr_innermost
+        curr_loop_depth += 1
+        curr_innermost = match body {
+            | KExpFor _ | KExpMap _ | KExpWhile _ | KExpDoWhile _ => false
+            | _ => !has_loops(body)
+            }
+        val body = inline_kexp_(body, callb)
+        curr_loop_depth -= 1
+        curr_innermost = saved_innermost
+        body
+    }
     fun inline_kexp_(e: kexp_t, callb: k_callb_t) =
         match e {
         | KDefFun kf =>
@@ -451,36 +522,100 @@ fun inline_some(kmods: kmodule_t list)
             | _ => throw compile_err(kf_loc,
                 "inline: function is not found the collected function database")
             }
+            val saved_loop_depth = curr_loop_depth
+            val saved_innermost = curr_innermost
             curr_fi = r_fi
+            curr_loop_depth = 0
+            curr_innermost = false
             val new_body = inline_kexp_(kf_body, callb)
             *kf = kf->{kf_body=new_body}
             curr_fi = saved_fi
+            curr_loop_depth = saved_loop_depth
+            curr_innermost = saved_innermost
             e
+        | KExpFor(idoml, at_ids, body, flags, loc) =>
+            KExpFor(idoml, at_ids, inline_loop_body_(body, callb), flags, loc)
+        | KExpMap(e_idoml_l, body, flags, ctx) =>
+            // the clause headers are computed before the corresponding loops start
+            val e_idoml_l = [for (e, idoml, at_ids) <- e_idoml_l {
+                (inline_kexp_(e, callb), idoml, at_ids) }]
+            KExpMap(e_idoml_l, inline_loop_body_(body, callb), flags, ctx)
+        // the loop condition is checked at every iteration, so it's the part of the loop body
+        | KExpWhile(c, body, loc) =>
+            val saved_innermost = curr_innermost
+            curr_loop_depth += 1
+            curr_innermost = !has_loops(e)
+            val c = inline_kexp_(c, callb)
+            val body = inline_kexp_(body, callb)
+            curr_loop_depth -= 1
+            curr_innermost = saved_innermost
+            KExpWhile(c, body, loc)
+        | KExpDoWhile(body, c, loc) =>
+            val saved_innermost = curr_innermost
+            curr_loop_depth += 1
+            curr_innermost = !has_loops(e)
+            val body = inline_kexp_(body, callb)
+            val c = inline_kexp_(c, callb)
+            curr_loop_depth -= 1
+            curr_innermost = saved_innermost
+            KExpDoWhile(body, c, loc)
         /* we do not expand inline calls at the top level of non-main module,
            because it may ruin some global variables */
-        | KExpCall (f, real_args, _)
+        | KExpCall (f, real_args, (_, loc))
             when curr_km_main || curr_fi->fi_name != noid =>
             match all_funcs_info.find_opt(f) {
             | Some r_fi when r_fi->fi_km_idx == curr_km_idx =>
                 val { fi_can_inline=caller_can_inline,
                       fi_size=caller_size,
-                      fi_flags=caller_flags } = *curr_fi
+                      fi_flags=caller_flags,
+                      fi_count=caller_count } = *curr_fi
                 val caller_is_inline = caller_can_inline && caller_flags.fun_flag_inline
                 val inline_thresh = Options.opt.inline_thresh
+                val is_hot = caller_count > 0 && caller_count*20 >= profile_max
+                val is_cold = caller_count == 0
+                // the calls inside loops are executed many times, so they get bigger budget,
+                // which grows with the loop nesting depth; the innermost loops get the biggest one.
+                // the weight is measured in halves of the base threshold
+                val loop_weight = if curr_loop_depth == 0 { 2 }
+                                  else { 2 + min(curr_loop_depth, 2) + (if curr_innermost { 2 } else { 0 }) }
+                val inline_thresh = if is_hot { inline_thresh * 2 } else { inline_thresh }
+                // the loop weight only affects the size of the inlined functions,
+                // the caller growth limit stays the same
                 val max_caller_size =
                     if caller_is_inline { inline_thresh * 3 / 2 }
                     else { inline_thresh * 10 }
+                val inline_thresh = inline_thresh * loop_weight / 2
                 val {fi_can_inline, fi_size, fi_flags} = *r_fi
                 val f_is_inline = fi_can_inline && fi_flags.fun_flag_inline
                 val f_max_size = if f_is_inline { inline_thresh * 3 / 2 }
+                                 else if is_cold { inline_thresh / 4 }
                                  else { inline_thresh }
                 val new_size = caller_size + fi_size - real_args.length() - 1
                 val new_size = max(new_size, 0)
-                if fi_can_inline && (fi_size <= f_max_size && new_size <= max_caller_size) {
-                    val (new_e, inlined) = expand_call(curr_km_idx, e)
-                    if inlined { *curr_fi = curr_fi->{fi_size=new_size} }
-                    new_e
-                } else { e }
+                val (new_e, inlined) =
+                    if fi_can_inline && (fi_size <= f_max_size && new_size <= max_caller_size) {
+                        expand_call(curr_km_idx, e)
+                    } else { (e, false) }
+                if inlined { *curr_fi = curr_fi->{fi_size=new_size} }
+                if Options.opt.inline_report && fi_flags.fun_flag_ctor == CtorNone && !fi_flags.fun_flag_ccode {
+                    val caller = if curr_fi->fi_name == noid {"<global code>"} else {f"'{pp(curr_fi->fi_name)}'"}
+                    val site = (if curr_loop_depth == 0 {""}
+                                else if curr_innermost {f", innermost loop of depth {curr_loop_depth}"}
+                                else {f", loop depth {curr_loop_depth}"}) +
+                               (if is_hot {", hot"} else if is_cold {", cold"} else {""})
+                    val decision =
+                        if inlined { f"inlined: size {fi_size} <= {f_max_size}" }
+                        else if !fi_can_inline {
+                            if fi_flags.fun_flag_recursive { "not inlined: recursive" }
+                            else { "not inlined: contains local functions or 'return'" }
+                        } else if fi_size > f_max_size { f"not inlined: size {fi_size} > {f_max_size}" }
+                        else if new_size > max_caller_size {
+                            f"not inlined: the caller would grow to {new_size} > {max_caller_size}"
+                        } else { "not inlined: contains local types or exceptions" }
+                    inline_decisions.add(f"{loc} {pp(f)}",
+                        (loc, f"call of '{pp(f)}' from {caller}{site}: {decision}"))
+                }
+                new_e
             | _ => e
             }
         | _ => walk_kexp(e, callb)
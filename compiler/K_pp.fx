@@ -567,3 +567,15 @@ fun pp_top_to_string(code: kexp_t list) {
     val all_lines = pp.get_f()
     join_embrace("", "\n", "\n", all_lines)
 }
+
+// computes hash of pp_top_to_string(code) without actually forming the text
+fun pp_top_to_hash(code: kexp_t list): hash_t {
+    val pp = PP.pprint_to_hash(margin, default_indent=default_indent)
+    pp.beginv(0)
+    for e@i <- code {
+        if i != 0 { pp.break0() }
+        pp_exp_(pp, e)
+    }
+    pp.newline(); pp.end()
+    pp.hash()
+}
@@ -163,6 +163,11 @@ fun reset_purity_flags(code: kexp_t list): void {
     }
 }
 
+// the symbols used by the modules, which C code is taken from the previous build
+// (see Compiler.k_skip_some()); they must be retained even though
+// the function bodies of such modules are not available anymore
+var used_by_skipped: id_hashset_t = empty_id_hashset(1)
+
 fun remove_unused(kmods: kmodule_t list, initial: bool)
 {
     for {km_top} <- kmods {
@@ -170,6 +175,7 @@ fun remove_unused(kmods: kmodule_t list, initial: bool)
     }
     val all_top = [for {km_top} <- kmods {km_top} ].concat()
     val used_somewhere = used_by(all_top, 1024)
+    used_somewhere.union(used_by_skipped)
 
     var fold_pairs = empty_idmap
     var is_main = false
@@ -238,12 +244,14 @@ fun remove_unused(kmods: kmodule_t list, initial: bool)
         | KDefVariant kvar =>
             /* if at least one of the variant constructors is used then
                the constructor call returns the variant type,
-               i.e. the variant name gets used. So, we may be sure that
-               we will never eliminate variant definition and yet retain
-               some of its used constructors. */
-            val {kvar_name, kvar_loc} = *kvar
+               i.e. the variant name gets used. But the call may be in another module,
+               where the variant has been copied to and renamed (see K_copy_n_skip),
+               so we also check the constructors explicitly in order to never eliminate
+               variant definition and yet retain some of its used constructors. */
+            val {kvar_name, kvar_ctors, kvar_loc} = *kvar
             check_m_idx(kvar_name, kvar_loc)
-            if used_somewhere.mem(kvar_name) {e} else {KExpNop(kvar_loc)}
+            if used_somewhere.mem(kvar_name) || exists(for c <- kvar_ctors {used_somewhere.mem(c)}) {e}
+            else {KExpNop(kvar_loc)}
         | KDefTyp kt =>
             val {kt_name, kt_loc} = *kt
             check_m_idx(kt_name, kt_loc)
@@ -377,6 +385,19 @@ fun remove_unused_by_main(kmods: kmodule_t list)
         deps.intersect(all_top_ids)
         all_deps.add(n, deps.compress())
     }
+    // the variant constructors do not mention the variant in used_by(), see remove_unused()
+    for (_, e) <- all_top {
+        match e {
+        | KDefVariant (ref {kvar_name, kvar_ctors}) =>
+            for c <- kvar_ctors {
+                match all_deps.find_opt(c) {
+                | Some(deps) => deps.add(kvar_name)
+                | _ => {}
+                }
+            }
+        | _ => {}
+        }
+    }
 
     // calculate and add to the hash table all the direct dependencies
     // of top-level non-declarations (i.e. actions)
@@ -0,0 +1,233 @@
+/*
+    This file is a part of ficus language project.
+    See ficus/LICENSE for the licensing terms
+*/
+
+/*
+    Specializes higher-order functions at the call sites where the functional
+    arguments are known.
+
+    When a function 'f(..., g: 'a -> 'b, ...)' is called with some known function 'h'
+    as 'g', the call is replaced with the call of a copy of 'f' (clone), where all
+    the occurences of 'g' are replaced with 'h' and 'g' is removed from the parameters.
+    Inside the clone the calls of 'g' via closure pointer become direct calls of 'h',
+    which can be further expanded by K_inline. This way we eliminate indirect calls and
+    closure reference counting from the inner loops of Array.sort(), List.map(),
+    Hashmap.app(), user combinators etc.
+
+    'h' can be a global function (including the lambda functions that do not need closures,
+    they are moved to the top level by K_lift_simple) or a local function.
+    In the first case the clone is put to the top level of the module, right before
+    the definition that contains the call, and it's shared between all the calls of 'f'
+    with the same functional arguments. In the second case the clone is put right before
+    the statement that contains the call, so that the clone can access the same free
+    variables as 'h'. In order to avoid creation of the closure for the clone on each
+    iteration, such a call is only specialized if it's in the same loop as the definition of 'h'.
+
+    Only non-recursive functions, defined at the top level of the same module, are specialized
+    (the instances of generic functions and small functions from the other modules are
+    copied to the module by K_copy_n_skip), and only if they are not too big and
+    actually call the functional parameter.
+*/
+
+from Ast import *
+from K_form import *
+import K_inline, Options
+import Hashmap, Hashset
+
+// checks whether the function parameter is called inside the expression
+fun calls_param(e: kexp_t, g: id_t)
+{
+    var found = false
+    fun fold_calls_ktyp_(t: ktyp_t, loc: loc_t, callb: k_fold_callb_t) {}
+    fun fold_calls_kexp_(e: kexp_t, callb: k_fold_callb_t) =
+        match e {
+        | KExpCall (f, _, _) when f == g => found = true
+        | _ => if !found { fold_kexp(e, callb) }
+        }
+    val calls_callb = k_fold_callb_t {
+        kcb_fold_atom=None,
+        kcb_fold_ktyp=Some(fold_calls_ktyp_),
+        kcb_fold_kexp=Some(fold_calls_kexp_)
+    }
+    fold_calls_kexp_(e, calls_callb)
+    found
+}
+
+// creates the copy of the function, where some of the parameters are replaced with the known functions
+fun clone_fun(km_idx: int, kf: kdeffun_t ref, fargs: (id_t, id_t) list, scope: scope_t list): kdeffun_t ref
+{
+    val {kf_name, kf_loc} = *kf
+    val empty_subst = Hashmap.empty(1, noid, AtomId(noid))
+    val (new_e, rename_map) = K_inline.subst_names(km_idx, KDefFun(kf), empty_subst, true)
+    match new_e {
+    | KDefFun new_kf =>
+        val subst_map = Hashmap.empty(8, noid, AtomId(noid))
+        for (g, h) <- fargs {
+            match rename_map.find_opt(g) {
+            | Some(AtomId(new_g)) => subst_map.add(new_g, AtomId(h))
+            | _ => throw compile_err(kf_loc, f"specialize: parameter '{pp(g)}' of '{pp(kf_name)}' was not renamed")
+            }
+        }
+        val {kf_params, kf_body} = *new_kf
+        val new_params = [for a <- kf_params when !subst_map.mem(a) {a}]
+        val (new_body, _) = K_inline.subst_names(km_idx, kf_body, subst_map, false)
+        *new_kf = new_kf->{kf_params=new_params, kf_body=new_body, kf_scope=scope}
+        new_kf
+    | _ => throw compile_err(kf_loc, f"specialize: unexpected result of '{pp(kf_name)}' copying")
+    }
+}
+
+fun specialize_hofs(km_idx: int, top_code: kcode_t): kcode_t
+{
+    val max_size = Options.opt.inline_thresh * 5
+    // the clones of functions specialized with global functions
+    val global_clones: (string, id_t) Hashmap.t = Hashmap.empty(16, "", noid)
+    // the local functions and the places where they are defined: (function level, loop depth, block level)
+    val local_funcs: (id_t, (int, int, int)) Hashmap.t = Hashmap.empty(16, noid, (0, 0, 0))
+    var new_top: kcode_t = []
+    var pending: kcode_t = []
+    var curr_fun_level = 0
+    var curr_loop_depth = 0
+    var curr_seq_level = 0
+    // the top-level functions of the module; note that some of them
+    // have been moved to the top level by K_lift_simple and so they keep the original scope
+    val top_funcs = empty_id_hashset(256)
+    for e <- top_code {
+        | KDefFun (ref {kf_name}) => top_funcs.add(kf_name)
+        | _ => {}
+    }
+    fun is_global_fun(f: id_t, kf_scope: scope_t list) =
+        top_funcs.mem(f) || curr_module(kf_scope) != km_idx
+
+    // returns (is_known, is_local, scope)
+    fun is_known_fun(h: id_t, loc: loc_t): (bool, bool, scope_t list) =
+        match kinfo_(h, loc) {
+        | KFun (ref {kf_flags, kf_scope}) when kf_flags.fun_flag_ctor == CtorNone =>
+            if is_global_fun(h, kf_scope) { (true, false, kf_scope) }
+            else {
+                match local_funcs.find_opt(h) {
+                | Some((fun_level, loop_depth, seq_level)) =>
+                    val ok = fun_level == curr_fun_level && loop_depth == curr_loop_depth &&
+                             curr_seq_level > 0 && curr_seq_level >= seq_level
+                    (ok, true, kf_scope)
+                | _ => (false, true, kf_scope)
+                }
+            }
+        | _ => (false, false, [])
+        }
+
+    fun try_specialize(f: id_t, args: atom_t list, loc: loc_t): (id_t, atom_t list)? =
+        match kinfo_(f, loc) {
+        | KFun kf =>
+            val {kf_params, kf_body, kf_flags, kf_scope} = *kf
+            val is_candidate = curr_module(kf_scope) == km_idx && top_funcs.mem(f) &&
+                               !kf_flags.fun_flag_recursive && !kf_flags.fun_flag_ccode &&
+                               kf_flags.fun_flag_ctor == CtorNone
+            // the functional arguments and the scope of the local function, if any
+            val fold fargs = [], have_local = false, local_scope = ([]: scope_t list)
+                for a <- kf_params, arg <- args {
+                match arg {
+                | AtomId h when is_candidate && h != f =>
+                    val (known, is_local, h_scope) = is_known_fun(h, loc)
+                    // a clone may only use one local function in order to be placed properly
+                    if known && !(is_local && have_local) && calls_param(kf_body, a) {
+                        ((a, h) :: fargs, have_local || is_local, if is_local {h_scope} else {local_scope})
+                    } else { (fargs, have_local, local_scope) }
+                | _ => (fargs, have_local, local_scope)
+                }
+            }
+            if fargs == [] || K_inline.calc_exp_size(kf_body) > max_size { None }
+            else {
+                val fargs = fargs.rev()
+                val key = string(f) + "".join([for (g, h) <- fargs {f"|{g}={h}"}])
+                val clone =
+                    if have_local {
+                        val clone_kf = clone_fun(km_idx, kf, fargs, local_scope)
+                        pending = KDefFun(clone_kf) :: pending
+                        clone_kf->kf_name
+                    } else {
+                        match global_clones.find_opt(key) {
+                        | Some(clone) => clone
+                        | _ =>
+                            val clone_kf = clone_fun(km_idx, kf, fargs, kf_scope)
+                            global_clones.add(key, clone_kf->kf_name)
+                            new_top = KDefFun(clone_kf) :: new_top
+                            clone_kf->kf_name
+                        }
+                    }
+                val new_args = [for a <- kf_params, arg <- args
+                                when !exists(for (g, _) <- fargs {g == a}) {arg}]
+                Some((clone, new_args))
+            }
+        | _ => None
+        }
+
+    fun spec_ktyp_(t: ktyp_t, loc: loc_t, callb: k_callb_t) = t
+    fun spec_kexp_(e: kexp_t, callb: k_callb_t) =
+        match e {
+        | KDefFun kf =>
+            val {kf_name, kf_body, kf_scope} = *kf
+            if !is_global_fun(kf_name, kf_scope) {
+                local_funcs.add(kf_name, (curr_fun_level, curr_loop_depth, curr_seq_level))
+            }
+            val saved_loop_depth = curr_loop_depth
+            val saved_seq_level = curr_seq_level
+            val saved_pending = pending
+            curr_fun_level += 1
+            curr_loop_depth = 0
+            curr_seq_level = 0
+            pending = []
+            val new_body = spec_kexp_(kf_body, callb)
+            *kf = kf->{kf_body=new_body}
+            curr_fun_level -= 1
+            curr_loop_depth = saved_loop_depth
+            curr_seq_level = saved_seq_level
+            pending = saved_pending
+            e
+        | KExpFor _ | KExpMap _ | KExpWhile _ | KExpDoWhile _ =>
+            curr_loop_depth += 1
+            val e = walk_kexp(e, callb)
+            curr_loop_depth -= 1
+            e
+        | KExpSeq (elist, (t, loc)) =>
+            val saved_pending = pending
+            curr_seq_level += 1
+            val fold new_elist = [] for ej <- elist {
+                pending = []
+                val ej = spec_kexp_(ej, callb)
+                ej :: (pending + new_elist)
+            }
+            curr_seq_level -= 1
+            pending = saved_pending
+            KExpSeq(new_elist.rev(), (t, loc))
+        | KExpCall (f, args, (t, loc)) =>
+            match try_specialize(f, args, loc) {
+            | Some((clone, new_args)) => KExpCall(clone, new_args, (t, loc))
+            | _ => e
+            }
+        | _ => walk_kexp(e, callb)
+        }
+
+    val spec_callb = k_callb_t {
+        kcb_atom=None,
+        kcb_ktyp=Some(spec_ktyp_),
+        kcb_kexp=Some(spec_kexp_)
+    }
+    val fold new_top_code = [] for e <- top_code {
+        new_top = []
+        val e = spec_kexp_(e, spec_callb)
+        e :: (new_top + new_top_code)
+    }
+    new_top_code.rev()
+}
+
+fun specialize_all(kmods: kmodule_t list)
+{
+    val _ = K_inline.find_recursive_funcs_all(kmods)
+    [for km <- kmods {
+        val {km_idx, km_top} = km
+        val new_top = specialize_hofs(km_idx, km_top)
+        km.{km_top=new_top}
+    }]
+}
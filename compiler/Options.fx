@@ -24,19 +24,31 @@ type options_t =
     defines: (string, optval_t) list = [];
     optim_iters: int = 0;
     inline_thresh: int = 100;
+    inline_report: bool = false;
+    jobs: int = 0;
+    lto: bool = false;
     enable_openmp: bool = true;
     relax: bool = false;
     use_preamble: bool = true;
     make_app: bool = true;
+    obj_cache: bool = true;
     optimize_level: int = 1;
     output_name: string = "";
+    pgo_gen: bool = false;
+    pgo_use: bool = false;
+    pgo_dir: string = "";
     print_ast0: bool = false;
     print_ast: bool = false;
     print_k0: bool = false;
     print_k: bool = false;
     print_tokens: bool = false;
     run_app: bool = false;
+    split_c: int = 0;
+    time_passes: bool = false;
+    time_passes_json: string = "";
+    unity: bool = false;
     verbose: bool = false;
+    watch: bool = false;
     W_unused: bool = true
 }
 
@@ -50,10 +62,11 @@ fun print_help(detailed: bool) {
     if !detailed {
         println(f"
 Usage: {fxname} [-pr-tokens | -pr-ast0 | -pr-ast | -pr-k0 | -pr-k | -no-c
-    | -app | -run | -O0 | -O1 | -O3 | -inline-threshold <n> | -no-openmp
-    | -o <output_name> | -I <incdir> | -B <build_root>
+    | -app | -run | -O0 | -O1 | -O3 | -inline-threshold <n> | -inline-report | -no-openmp
+    | -o <output_name> | -I <incdir> | -B <build_root> | -j <n> | -split-c <n>
+    | -unity | -lto | -pgo-gen | -pgo-use <profile_dir>
     | -c++ | -cflags <cflags> | -clibs <clibs>
-    | -verbose | -h | -v ] <input_file>.fx [-- <app_args ...>]
+    | -verbose | -time-passes | -watch | -h | -v ] <input_file>.fx [-- <app_args ...>]
 
 Run '{fxname} -h' to get more detailed help")
     } else {
@@ -77,12 +90,24 @@ where options can be some of:
     -O1             Optimization level 1 (default): enable most of the optimizations
     -O3             Optimization level 3: enable all optimizations
     -no-openmp      Disable OpenMP (OpenMP is enabled by default)
+    -unity          Compile all the generated C code as a single file, so that C compiler
+                    could inline functions across modules. It takes more time to build the app,
+                    and the whole file is recompiled after any change
+    -lto            Enable link-time optimization in C compiler (-flto or /GL)
+    -pgo-gen        Build the instrumented application that collects the execution profile
+                    into <build_dir>/pgo each time it runs (e.g. with -run)
+    -pgo-use <profile_dir> Use the collected profile to optimize the application:
+                    C compiler optimizes the hot code paths, and the calls from the hot functions
+                    are inlined more aggressively
     -debug          Turn on debug information, disable optimizations
                     (but it can be overwritten with further -On)
     -optim-iters    The number of optimization iterations to perform (2 or 3 by default, depending on -O<n>)
     -inline-threshold  Inline threshold (100 by default); the higher it is,
                     the bigger functions are inlined;
-                    --inline-thresh=0 disables inline expansion
+                    -inline-threshold 0 disables inline expansion.
+                    The calls inside loops, especially the innermost ones,
+                    use proportionally bigger threshold
+    -inline-report  Print the inline expansion decision for each call site
     -relax          Do not require explicit typing of all global functions' parameters
     -no-preamble    Do not auto-import 'Builtins', 'List', 'String' and
                     a few other standard modules into each compiled module.
@@ -102,6 +127,13 @@ where options can be some of:
     -B <build_root> Specifies the parent directory <build_root> where subdirectory
                     <build_root>/__fxbuild__/<app_build_dir> with the generated files will be created.
                     By default, <build_root> is the current working directory.
+    -no-obj-cache   Do not use the shared cache of object files. By default, the object files
+                    are stored in and reused from $FICUS_CACHE_DIR or, if it's not set,
+                    ~/.cache/ficus. The cache size is limited by $FICUS_CACHE_SIZE megabytes (1024 by default)
+    -j <n>          Run at most <n> C compiler processes simultaneously. By default,
+                    it's the number of CPU cores minus the current system load
+    -split-c <n>    Split each generated C module with more than <n> C statements into
+                    several files that are compiled in parallel (by default, modules are not split)
     -c++            Use C++ compiler instead of C to compile the generated sources.
                     'pragma \"c++\"' in .fx file also instructs ficus compiler to use C++.
     -cflags <cflags> Pass the specified flags, e.g. \"-mavx2\", to C/C++ compiler.
@@ -111,6 +143,15 @@ where options can be some of:
                     If environment variable FICUS_LINK_LIBRARIES is set,
                     its value is inserted after <clibs>
     -verbose        Display various info during the build
+    -time-passes    Print the time spent in each compilation stage and each K-form
+                    optimization pass, the amount of memory allocated there
+                    and the size of K-form (the number of expressions) after the pass
+    -time-passes-json <file> Same as -time-passes, but also store the collected
+                    statistics in the specified file in JSON format
+    -watch          Do not exit after the build; wait for changes in the source files
+                    of the application (including the imported modules) and rebuild it.
+                    The unchanged files are not read and tokenized again.
+                    The compiler exits when the main source file stays removed for a few seconds
     -h or -help or --help  Display this information
     -v or -version  Display information about compiler and the platform, then exit.
     --              Specify the application parameters when '-run' flag is used,
@@ -160,6 +201,16 @@ fun parse_options(): bool {
                 opt.optimize_level = 3; next
             | "-no-openmp" :: next =>
                 opt.enable_openmp = false; next
+            | "-unity" :: next =>
+                opt.unity = true; next
+            | "-lto" :: next =>
+                opt.lto = true; next
+            | "-pgo-gen" :: next =>
+                opt.pgo_gen = true; next
+            | "-pgo-use" :: dir :: next =>
+                opt.pgo_use = true
+                opt.pgo_dir = Filename.normalize(curr_dir, dir)
+                next
             | "-debug" :: next =>
                 opt.debug = true; next
             | "-optim-iters" :: i :: next =>
@@ -173,17 +224,45 @@ fun parse_options(): bool {
             | "-inline-threshold" :: i :: next =>
                 val i = i.to_int_or(-1)
                 if i >= 0 {
-                    opt.optim_iters = i; next
+                    opt.inline_thresh = i; next
                 } else {
                     println(f"{error} invalid -inline-threshold argument; must be a non-negative integer")
                     ok = false; []
                 }
+            | "-inline-report" :: next =>
+                opt.inline_report = true; next
+            | "-j" :: n :: next =>
+                val n = n.to_int_or(-1)
+                if n > 0 {
+                    opt.jobs = n; next
+                } else {
+                    println(f"{error} invalid -j argument; must be a positive integer")
+                    ok = false; []
+                }
+            | "-split-c" :: n :: next =>
+                val n = n.to_int_or(-1)
+                if n >= 0 {
+                    opt.split_c = n; next
+                } else {
+                    println(f"{error} invalid -split-c argument; must be a non-negative integer")
+                    ok = false; []
+                }
             | "-relax" :: next =>
                 opt.relax = true; next
             | "-Wno-unused" :: next =>
                 opt.W_unused = false; next
             | "-verbose" :: next =>
                 opt.verbose = true; next
+            | "-no-obj-cache" :: next =>
+                opt.obj_cache = false; next
+            | "-watch" :: next =>
+                opt.watch = true; next
+            | "-time-passes" :: next =>
+                opt.time_passes = true; next
+            | "-time-passes-json" :: fname :: next =>
+                opt.time_passes = true
+                opt.time_passes_json = Filename.normalize(curr_dir, fname)
+                next
             | "-o" :: oname :: next =>
                 opt.output_name = oname; next
             | "-D" :: nameval :: next =>
@@ -246,7 +325,7 @@ fun parse_options(): bool {
                 opt.app_args = next; []
             | a :: next =>
                 if a.startswith("-") {
-                    if ["-inline-threshold", "-o", "-B", "-cflags", "-clibs"].mem(a) {
+                    if ["-inline-threshold", "-j", "-split-c", "-pgo-use", "-o", "-B", "-cflags", "-clibs", "-time-passes-json"].mem(a) {
                         println(f"{error} option {a} needs an argument")
                     } else {
                         println(f"{error} unrecognized option {a}")
@@ -279,6 +358,10 @@ fun parse_options(): bool {
             println(f"{error} -no-c option cannot be used together with -run or -c++")
             ok = false
         }
+        if opt.pgo_gen && opt.pgo_use {
+            println(f"{error} -pgo-gen and -pgo-use options cannot be used together")
+            ok = false
+        }
     }
     if prver {
         println(f"Ficus version: {__ficus_version_str__} (git commit: {__ficus_git_commit__})")
@@ -300,6 +383,7 @@ fun parse_options(): bool {
         opt.app_filename = if opt.output_name != "" { opt.output_name } else { default_output_name }
         opt.build_dir = Filename.normalize(opt.build_rootdir, Filename.basename(opt.app_filename))
         if opt.output_name == "" { opt.app_filename = Filename.normalize(opt.build_dir, opt.app_filename) }
+        if opt.pgo_gen { opt.pgo_dir = Filename.normalize(opt.build_dir, "pgo") }
         opt.app_args = opt.app_args.rev()
         true
     } else { false }
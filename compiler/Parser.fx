@@ -2420,6 +2420,9 @@ fun preprocess(ts: tklist_t): tklist_t
     ppnext(ts, [], [])
 }
 
+var tokens_cache: (string, (double, (Lexer.token_t, Ast.loc_t) list)) Hashmap.t =
+    Hashmap.empty(64, "", (0., []))
+
 fun parse(m_idx: int, preamble: token_t list, inc_dirs: string list): bool
 {
     var dm = all_modules[m_idx]
@@ -2436,35 +2439,46 @@ fun parse(m_idx: int, preamble: token_t list, inc_dirs: string list): bool
     dm.dm_parsed = true
     all_modules[m_idx].dm_parsed = true
 
-    val strm = try Lxu.make_stream(dm.dm_filename)
-        catch {
-        | FileOpenError => throw ParseError(parser_ctx.default_loc, "cannot open file")
-        | IOError => throw ParseError(parser_ctx.default_loc, "cannot read file")
-        }
-    val lexer = make_lexer(strm)
+    // in the watch mode the tokens of the unchanged files are taken from the cache
+    val mtime = if Options.opt.watch && !Options.opt.print_tokens {
+        Filename.getmtime(dm.dm_filename)} else {-1.}
+    var all_tokens: (Lexer.token_t, Ast.loc_t) list =
+        match tokens_cache.find_opt(dm.dm_filename) {
+        | Some((t, tokens)) when mtime >= 0. && t == mtime =>
+            [for (tk, loc) <- tokens {(tk, loc.{m_idx=dm.dm_idx})}]
+        | _ => []
+        }
+    if all_tokens.empty() {
+        val strm = try Lxu.make_stream(dm.dm_filename)
+            catch {
+            | FileOpenError => throw ParseError(parser_ctx.default_loc, "cannot open file")
+            | IOError => throw ParseError(parser_ctx.default_loc, "cannot read file")
+            }
+        val lexer = make_lexer(strm)
 
-    // [TODO] perhaps, need to avoid fetching all the tokens at once
-    var all_tokens: (Lexer.token_t, Ast.loc_t) list = []
-    var prev_lineno = -1
-    while true {
-        val more_tokens = lexer()
-        for (t, (lineno, col)) <- more_tokens {
-            val loc = Ast.loc_t {m_idx=dm.dm_idx, line0=lineno, col0=col, line1=lineno, col1=col}
-            if Options.opt.print_tokens {
-                if lineno != prev_lineno {
-                    print(f"\n{pp(fname_id)}:{lineno}: ")
-                    prev_lineno = lineno
+        // [TODO] perhaps, need to avoid fetching all the tokens at once
+        var prev_lineno = -1
+        while true {
+            val more_tokens = lexer()
+            for (t, (lineno, col)) <- more_tokens {
+                val loc = Ast.loc_t {m_idx=dm.dm_idx, line0=lineno, col0=col, line1=lineno, col1=col}
+                if Options.opt.print_tokens {
+                    if lineno != prev_lineno {
+                        print(f"\n{pp(fname_id)}:{lineno}: ")
+                        prev_lineno = lineno
+                    }
+                    print(f"{Lexer.tok2str(t).0} ")
                 }
-                print(f"{Lexer.tok2str(t).0} ")
+                all_tokens = (t, loc) :: all_tokens
+            }
+            match all_tokens {
+            | (Lexer.EOF, _) :: _ => break
+            | _ => {}
             }
-            all_tokens = (t, loc) :: all_tokens
-        }
-        match all_tokens {
-        | (Lexer.EOF, _) :: _ => break
-        | _ => {}
         }
+        all_tokens = all_tokens.rev()
+        if mtime >= 0. { tokens_cache.add(dm.dm_filename, (mtime, all_tokens)) }
     }
-    all_tokens = all_tokens.rev()
     for t <- preamble.rev() { all_tokens = (t, parser_ctx.default_loc) :: all_tokens }
     all_tokens = preprocess(all_tokens)
     dm.dm_defs = parse_expseq(all_tokens, true).1
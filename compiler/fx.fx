@@ -6,5 +6,6 @@
 import Options, Compiler
 
 val ok = Options.parse_options()
-val ok = ok && Compiler.process_all(Options.opt.filename)
+val ok = ok && (if Options.opt.watch {Compiler.watch_all(Options.opt.filename)}
+               else {Compiler.process_all(Options.opt.filename)})
 if !ok {throw Exit(1)}
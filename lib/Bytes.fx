@@ -0,0 +1,204 @@
+/*
+    This file is a part of ficus language project.
+    See ficus/LICENSE for the licensing terms
+*/
+
+/*
+    Byte strings.
+
+    'string' is UTF-32, so keeping binary or ASCII data (network protocols,
+    file formats etc.) in strings takes 4x more memory than necessary,
+    whereas plain 'uint8 []' lacks the string operations.
+    Bytes.t is an immutable slice of a reference-counted byte array.
+    Slicing does not copy the data, the slice shares the buffer with the original,
+    and the conversion from/to 'uint8 []' is zero-copy whenever possible.
+*/
+
+import File
+
+class t { data: uint8 []; ofs: int; len: int }
+
+fun from_array(a: uint8 []): Bytes.t = t {data=a, ofs=0, len=size(a)}
+fun empty(): Bytes.t = t {data=[], ofs=0, len=0}
+
+// encodes the string using UTF-8
+fun from_string(s: string): Bytes.t
+{
+    fun encode_(s: string): uint8 [] =
+    @ccode {
+        fx_cstr_t cstr;
+        int fx_status = fx_str2cstr(s, &cstr, 0, 0);
+        if (fx_status >= 0) {
+            int_ len = (int_)cstr.length;
+            fx_status = fx_make_arr(1, &len, 1, 0, 0, cstr.data, fx_result);
+            fx_free_cstr(&cstr);
+        }
+        return fx_status;
+    }
+    from_array(encode_(s))
+}
+
+// returns the underlying array, if the byte string covers it completely,
+// or a copy of the corresponding part of the array otherwise
+fun array(b: Bytes.t): uint8 [] =
+    if b.ofs == 0 && b.len == size(b.data) {b.data}
+    else {b.data[b.ofs:b.ofs+b.len]}
+
+// decodes the byte string as UTF-8
+fun to_string(b: Bytes.t): string
+{
+    fun decode_(data: uint8 [], ofs: int, len: int): string =
+    @ccode { return fx_cstr2str((const char*)data->data + ofs, len, fx_result) }
+    decode_(b.data, b.ofs, b.len)
+}
+
+@inline fun length(b: Bytes.t) = b.len
+@inline fun empty(b: Bytes.t) = b.len == 0
+
+fun at(b: Bytes.t, i: int): uint8
+{
+    if i < 0 || i >= b.len {throw OutOfRangeError}
+    b.data[b.ofs + i]
+}
+
+// returns b[i:j]; the indices are clipped like in the case of string slicing
+fun slice(b: Bytes.t, i: int, j: int): Bytes.t
+{
+    val i = min(max(i, 0), b.len), j = min(max(j, i), b.len)
+    t {data=b.data, ofs=b.ofs+i, len=j-i}
+}
+
+@private @pure @nothrow fun find_(data: uint8 [], ofs: int, len: int, start: int,
+                                  sub: uint8 [], subofs: int, sublen: int): int =
+@ccode {
+    // memchr() and memcmp() are vectorized in most C standard libraries
+    const uint8_t* ptr = (const uint8_t*)data->data + ofs;
+    const uint8_t* subptr = (const uint8_t*)sub->data + subofs;
+    int_ i = start < 0 ? 0 : start;
+    if (sublen == 0)
+        return i <= len ? i : -1;
+    for (; i + sublen <= len; i++) {
+        const uint8_t* p = (const uint8_t*)memchr(ptr + i, subptr[0], (size_t)(len - sublen + 1 - i));
+        if (!p)
+            break;
+        i = (int_)(p - ptr);
+        if (memcmp(p + 1, subptr + 1, (size_t)(sublen - 1)) == 0)
+            return i;
+    }
+    return -1;
+}
+
+// finds the first occurence of 'sub' in 'b' starting from 'start'
+fun find(b: Bytes.t, sub: Bytes.t, ~start: int=0): int =
+    find_(b.data, b.ofs, b.len, start, sub.data, sub.ofs, sub.len)
+
+@private @pure @nothrow fun findbyte_(data: uint8 [], ofs: int, len: int, start: int, c: uint8): int =
+@ccode {
+    const uint8_t* ptr = (const uint8_t*)data->data + ofs;
+    const uint8_t* p;
+    if (start < 0)
+        start = 0;
+    if (start >= len)
+        return -1;
+    p = (const uint8_t*)memchr(ptr + start, c, (size_t)(len - start));
+    return p ? (int_)(p - ptr) : -1;
+}
+
+fun find(b: Bytes.t, c: uint8, ~start: int=0): int =
+    findbyte_(b.data, b.ofs, b.len, start, c)
+
+@inline fun contains(b: Bytes.t, sub: Bytes.t) = find(b, sub) >= 0
+
+@private @pure @nothrow fun compare_(a: uint8 [], aofs: int, b: uint8 [], bofs: int, len: int): int =
+@ccode {
+    int r = memcmp((const uint8_t*)a->data + aofs, (const uint8_t*)b->data + bofs, (size_t)len);
+    return (r > 0) - (r < 0);
+}
+
+fun startswith(b: Bytes.t, prefix: Bytes.t) =
+    prefix.len <= b.len && compare_(b.data, b.ofs, prefix.data, prefix.ofs, prefix.len) == 0
+
+fun endswith(b: Bytes.t, suffix: Bytes.t) =
+    suffix.len <= b.len &&
+    compare_(b.data, b.ofs + b.len - suffix.len, suffix.data, suffix.ofs, suffix.len) == 0
+
+operator == (a: Bytes.t, b: Bytes.t) =
+    a.len == b.len && compare_(a.data, a.ofs, b.data, b.ofs, a.len) == 0
+
+operator <=> (a: Bytes.t, b: Bytes.t)
+{
+    val r = compare_(a.data, a.ofs, b.data, b.ofs, min(a.len, b.len))
+    if r != 0 {r} else {a.len <=> b.len}
+}
+
+operator + (a: Bytes.t, b: Bytes.t): Bytes.t =
+    if a.len == 0 {b} else if b.len == 0 {a}
+    else {from_array([| \array(a), \array(b) |])}
+
+// splits the byte string into the fields separated by 'sep'
+// (see String.split() about 'allow_empty'); the fields share the buffer with 'b'
+fun split(b: Bytes.t, sep: uint8, ~allow_empty: bool): Bytes.t []
+{
+    fun next_sep(start: int) {
+        val i = find(b, sep, start=start)
+        if i < 0 {b.len} else {i}
+    }
+    // count the fields first, so that the array is allocated just once
+    fun count_fields(start: int, n: int): int =
+        if start >= b.len {n}
+        else {
+            val i = next_sep(start)
+            count_fields(i + 1, if i > start || allow_empty {n + 1} else {n})
+        }
+    val n = count_fields(0, 0)
+    val fields = array(n, empty())
+    var start = 0, k = 0
+    while k < n {
+        val i = next_sep(start)
+        if i > start || allow_empty {
+            fields[k] = slice(b, start, i)
+            k += 1
+        }
+        start = i + 1
+    }
+    fields
+}
+
+fun hash(b: Bytes.t): hash_t
+{
+    @pure @nothrow fun hash_(data: uint8 [], ofs: int, len: int): hash_t =
+    @ccode {
+        const uint8_t* ptr = (const uint8_t*)data->data + ofs;
+        uint64_t hash = 14695981039346656037ULL;
+        for(int_ i = 0; i < len; i++) {
+            hash ^= ptr[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+    hash_(b.data, b.ofs, b.len)
+}
+
+fun string(b: Bytes.t) = "b\"" + to_string(b).escaped(quotes=false) + "\""
+fun print(b: Bytes.t) = print(string(b))
+
+fun read(fname: string): Bytes.t = from_array(File.read_binary_u8(fname))
+
+fun write(f: File.t, b: Bytes.t): void
+{
+    fun write_(f: File.t, data: uint8 [], ofs: int, len: int): void =
+    @ccode {
+        if(!f->handle || !f->handle->ptr)
+            FX_FAST_THROW_RET(FX_EXN_NullFileError);
+        size_t count = fwrite((const uint8_t*)data->data + ofs, 1, (size_t)len, (FILE*)f->handle->ptr);
+        return count == (size_t)len ? FX_OK : FX_SET_EXN_FAST(FX_EXN_IOError);
+    }
+    write_(f, b.data, b.ofs, b.len)
+}
+
+fun write(fname: string, b: Bytes.t): void
+{
+    val f = File.open(fname, "wb")
+    write(f, b)
+    f.close()
+}
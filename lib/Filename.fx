@@ -10,8 +10,12 @@
     #include <sys/stat.h>
 #if defined WIN32 || defined _WIN32
     #include <direct.h>
+    #include <windows.h>
+    #include <sys/utime.h>
 #else
     #include <unistd.h>
+    #include <dirent.h>
+    #include <utime.h>
 #endif
     #ifndef PATH_MAX
     #define PATH_MAX 8192
@@ -123,6 +127,122 @@ fun exists(name: string): bool
     return fx_status;
 }
 
+// returns the last modification time of the file (in seconds since the Epoch) or -1 if the file does not exist
+fun getmtime(name: string): double
+@ccode {
+    fx_cstr_t name_;
+    int fx_status = fx_str2cstr(name, &name_, 0, 0);
+    if (fx_status >= 0) {
+        struct stat s;
+        if (stat(name_.data, &s) != 0)
+            *fx_result = -1.;
+        else {
+    #if defined __linux__
+            *fx_result = (double)s.st_mtim.tv_sec + s.st_mtim.tv_nsec*1e-9;
+    #else
+            *fx_result = (double)s.st_mtime;
+    #endif
+        }
+        fx_free_cstr(&name_);
+    }
+    return fx_status;
+}
+
+// returns the size of the file in bytes or -1 if the file does not exist
+fun getsize(name: string): int64
+@ccode {
+    fx_cstr_t name_;
+    int fx_status = fx_str2cstr(name, &name_, 0, 0);
+    if (fx_status >= 0) {
+        struct stat s;
+        *fx_result = stat(name_.data, &s) == 0 ? (int64_t)s.st_size : -1;
+        fx_free_cstr(&name_);
+    }
+    return fx_status;
+}
+
+// sets the last access and modification time of the existing file to the current time.
+// Returns false if the file does not exist or its time can not be changed
+fun touch(name: string): bool
+@ccode {
+    fx_cstr_t name_;
+    int fx_status = fx_str2cstr(name, &name_, 0, 0);
+    if (fx_status >= 0) {
+    #if defined WIN32 || defined _WIN32
+        *fx_result = _utime(name_.data, 0) == 0;
+    #else
+        *fx_result = utime(name_.data, 0) == 0;
+    #endif
+        fx_free_cstr(&name_);
+    }
+    return fx_status;
+}
+
+// returns the names of all the entries in the directory, except for '.' and '..'
+fun listdir(path: string): string list
+{
+    // the names are separated by '\n'
+    fun listdir_(path: string): string = @ccode {
+        fx_cstr_t path_;
+        char* buf = 0;
+        size_t bufsz = 0, len = 0;
+        int fx_status = fx_str2cstr(path, &path_, 0, 0);
+        if (fx_status < 0)
+            return fx_status;
+    #if defined WIN32 || defined _WIN32
+        char pattern[PATH_MAX+16];
+        WIN32_FIND_DATAA fd;
+        HANDLE h;
+        snprintf(pattern, sizeof(pattern), "%s\\*", path_.data);
+        h = FindFirstFileA(pattern, &fd);
+        if (h == INVALID_HANDLE_VALUE)
+            fx_status = FX_SET_EXN_FAST(FX_EXN_FileOpenError);
+        else {
+            do {
+                const char* name = fd.cFileName;
+    #else
+        DIR* d = opendir(path_.data);
+        struct dirent* e;
+        if (!d)
+            fx_status = FX_SET_EXN_FAST(FX_EXN_FileOpenError);
+        else {
+            while ((e = readdir(d)) != 0) {
+                const char* name = e->d_name;
+    #endif
+                size_t namelen = strlen(name);
+                if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+                    continue;
+                if (len + namelen + 1 > bufsz) {
+                    char* newbuf;
+                    bufsz = (len + namelen + 1)*2 + 256;
+                    newbuf = (char*)fx_realloc(buf, bufsz);
+                    if (!newbuf) {
+                        fx_status = FX_SET_EXN_FAST(FX_EXN_OutOfMemError);
+                        break;
+                    }
+                    buf = newbuf;
+                }
+                memcpy(buf + len, name, namelen);
+                len += namelen;
+                buf[len++] = '\n';
+    #if defined WIN32 || defined _WIN32
+            } while (FindNextFileA(h, &fd));
+            FindClose(h);
+        }
+    #else
+            }
+            closedir(d);
+        }
+    #endif
+        if (fx_status >= 0)
+            fx_status = fx_cstr2str(buf, (int_)len, fx_result);
+        fx_free(buf);
+        fx_free_cstr(&path_);
+        return fx_status;
+    }
+    listdir_(path).split('\n', allow_empty=false)
+}
+
 // throws NotFoundError if there is no such file in specified directories
 fun locate(name: string, dirs: string list): string
 {
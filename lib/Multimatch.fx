@@ -0,0 +1,48 @@
+/*
+    This file is a part of ficus language project.
+    See ficus/LICENSE for the licensing terms
+*/
+
+// Finds all the occurrences of many fixed strings in a single pass over the text.
+// See runtime/ficus/impl/multimatch.impl.h for more information.
+// The compiled matcher is immutable, so it can be used inside @parallel loops.
+
+import Bytes
+
+class t { handle: cptr; patterns: string [] }
+
+fun compile(patterns: string []): t
+{
+    fun compile_(patterns: string []): cptr =
+    @ccode { return fx_mm_compile(patterns, fx_result) }
+    t { handle=compile_(patterns), patterns=patterns }
+}
+
+// returns the array of (pattern index, start position) pairs,
+// sorted by the end position of each match
+fun find_all(mm: t, s: string): (int, int) []
+{
+    fun find_(mm: cptr, s: string, first_only: bool): (int, int) [] =
+    @ccode { return fx_mm_find(mm, s->data, (int)sizeof(char_), s->length, first_only, fx_result) }
+    find_(mm.handle, s, false)
+}
+
+// the bytes are compared with the character codes, i.e. the byte string is treated as Latin-1:
+// the pattern characters U+0080..U+00FF match the bytes with the same values
+// (not their UTF-8 encodings), and the patterns with other non-ASCII characters never match
+fun find_all(mm: t, b: Bytes.t): (int, int) []
+{
+    fun find_(mm: cptr, data: uint8 [], ofs: int, len: int, first_only: bool): (int, int) [] =
+    @ccode { return fx_mm_find(mm, (const uint8_t*)data->data + ofs, 1, len, first_only, fx_result) }
+    find_(mm.handle, b.data, b.ofs, b.len, false)
+}
+
+fun find_all_str(mm: t, s: string): (string, int) [] =
+    [| for (p, i) <- find_all(mm, s) {(mm.patterns[p], i)} |]
+
+fun contains_any(mm: t, s: string): bool
+{
+    fun find_(mm: cptr, s: string, first_only: bool): (int, int) [] =
+    @ccode { return fx_mm_find(mm, s->data, (int)sizeof(char_), s->length, first_only, fx_result) }
+    size(find_(mm.handle, s, true)) > 0
+}
@@ -45,6 +45,8 @@ type state_t =
     pp_stack: (int, ppstyle_t) []
     pp_top: int=0
     emptystack: bool=true
+    hash_only: bool=false
+    hash: hash_t=0UL
 }
 
 class t
@@ -110,6 +112,23 @@ fun pprint_to_file(margin: int, f: File.t, ~default_indent: int=4): t
     make_pprinter(margin, print_f, no_get, default_indent=default_indent)
 }
 
+// The printer that does not format anything, it just computes hash of the token stream.
+// The formatted text is completely determined by the tokens, so two texts are
+// the same (modulo hash collisions) if their hashes are the same,
+// and the hash is computed much faster than the text.
+fun pprint_to_hash(margin: int, ~default_indent: int=4): t
+{
+    val pp = make_pprinter(margin, fun (_: string) {}, no_get, default_indent=default_indent)
+    pp.r->hash_only = true
+    pp.r->hash = FNV_1A_OFFSET
+    pp
+}
+
+fun hash(pp: PP.t): hash_t = pp.r->hash
+
+@private fun mix_hash(pp: PP.t, x: hash_t) =
+    pp.r->hash = (pp.r->hash ^ x) * FNV_1A_PRIME
+
 fun pprint_to_stdout(margin: int, ~default_indent: int=4): t =
     pprint_to_file(margin, File.stdout, default_indent=default_indent)
 
@@ -139,23 +158,30 @@ fun beginv(pp: PP.t, indent: int) = begin(pp, indent, Consistent)
 
 fun begin(pp: PP.t, indent: int, style: ppstyle_t): void
 {
-    val right = if pp.r->emptystack {
-        pp.r->lefttotal = 1
-        pp.r->righttotal = 1
-        pp.r->left = 0
-        pp.r->right = 0
-        0
+    if pp.r->hash_only {
+        mix_hash(pp, uint64(match style { | Auto => 1 | Fits => 2 | _ => 3 }))
+        mix_hash(pp, uint64(indent))
     } else {
-        advance_right(pp)
+        val right = if pp.r->emptystack {
+            pp.r->lefttotal = 1
+            pp.r->righttotal = 1
+            pp.r->left = 0
+            pp.r->right = 0
+            0
+        } else {
+            advance_right(pp)
+        }
+        val tk = PPBegin(indent, style)
+        pp.r->q[right] = (tk, -pp.r->righttotal)
+        scan_push(pp, right)
     }
-    val tk = PPBegin(indent, style)
-    pp.r->q[right] = (tk, -pp.r->righttotal)
-    scan_push(pp, right)
 }
 
 fun end(pp: PP.t): void
 {
-    if pp.r->emptystack {
+    if pp.r->hash_only {
+        mix_hash(pp, 4UL)
+    } else if pp.r->emptystack {
         pprint(pp, PPEnd, 0)
     } else {
         val right = advance_right(pp)
@@ -166,20 +192,25 @@ fun end(pp: PP.t): void
 
 fun br(pp: PP.t, spaces: int, offset: int, ~sep: char='\0'): void
 {
-    val right = if pp.r->emptystack {
-        pp.r->lefttotal = 1
-        pp.r->righttotal = 1
-        pp.r->left = 0
-        pp.r->right = 0
-        0
+    if pp.r->hash_only {
+        mix_hash(pp, uint64(spaces)*65536UL + uint64(ord(sep))*5UL + 5UL)
+        mix_hash(pp, uint64(offset))
     } else {
-        advance_right(pp)
+        val right = if pp.r->emptystack {
+            pp.r->lefttotal = 1
+            pp.r->righttotal = 1
+            pp.r->left = 0
+            pp.r->right = 0
+            0
+        } else {
+            advance_right(pp)
+        }
+        check_stack(pp, 0)
+        scan_push(pp, right)
+        val tk = PPBreak(spaces, offset, sep)
+        pp.r->q[right] = (tk, -pp.r->righttotal)
+        pp.r->righttotal += spaces
     }
-    check_stack(pp, 0)
-    scan_push(pp, right)
-    val tk = PPBreak(spaces, offset, sep)
-    pp.r->q[right] = (tk, -pp.r->righttotal)
-    pp.r->righttotal += spaces
 }
 
 fun cut(pp: PP.t) = br(pp, 0, 0)
@@ -195,13 +226,17 @@ fun newlineu(pp: PP.t) = br(pp, pp.margin, -pp.default_indent)
 
 fun str(pp: PP.t, s: string): void
 {
-    val tk = PPString(s), l = s.length()
-    if pp.r->emptystack {
-        pprint(pp, tk, l)
+    if pp.r->hash_only {
+        mix_hash(pp, hash(s))
     } else {
-        pp.r->q[advance_right(pp)] = (tk, l)
-        pp.r->righttotal += l
-        check_stream(pp)
+        val tk = PPString(s), l = s.length()
+        if pp.r->emptystack {
+            pprint(pp, tk, l)
+        } else {
+            pp.r->q[advance_right(pp)] = (tk, l)
+            pp.r->righttotal += l
+            check_stream(pp)
+        }
     }
 }
 
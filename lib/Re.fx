@@ -51,6 +51,14 @@ fun fullmatch(regex: t, str: string,
     fullmatch_(regex, str, ignorecase, multiline)
 }
 
+// checks which of the strings match the regexp completely.
+// The strings are processed in parallel
+fun match_many(regex: t, strs: string [],
+    ~ignorecase:bool=false, ~multiline:bool=false): bool [] =
+    [| @parallel for s <- strs {
+        fullmatch(regex, s, ignorecase=ignorecase, multiline=multiline)
+    } |]
+
 fun find(regex: t, str: string,
     ~ignorecase:bool=false, ~multiline:bool=false): (int, int) []?
 {
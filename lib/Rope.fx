@@ -0,0 +1,186 @@
+/*
+    This file is a part of ficus language project.
+    See ficus/LICENSE for the licensing terms
+*/
+
+/*
+    Ropes, i.e. immutable strings with cheap edits.
+
+    A rope is a balanced (AVL) binary tree, where leaves are string chunks.
+    Concatenation, insertion, deletion and slicing take O(log n) operations
+    instead of O(n) for the plain strings, which makes rope a good choice
+    for text editors, templating engines and other programs that incrementally
+    build or modify big texts. The chunks are never modified in place,
+    so the ropes can share them; splitting a chunk does not copy it either,
+    since string slices share the buffer with the original string.
+*/
+
+type tree_t = Empty | Leaf: string | Node: {height: int; length: int; left: tree_t; right: tree_t}
+class t { root: tree_t }
+
+// small neighbor chunks are merged to keep the tree compact
+val MAX_MERGED_CHUNK = 256
+
+@private fun height_(t: tree_t) {
+    | Node {height} => height
+    | _ => 0
+}
+
+@private fun length_(t: tree_t) {
+    | Node {length} => length
+    | Leaf(s) => s.length()
+    | _ => 0
+}
+
+@private fun leaf_(s: string) = if s.empty() {Empty} else {Leaf(s)}
+
+@private fun node_(l: tree_t, r: tree_t) =
+    Node {height=max(height_(l), height_(r)) + 1,
+          length=length_(l) + length_(r), left=l, right=r}
+
+// constructs the node from the subtrees, which heights differ by 2 at most
+@private fun balance_(l: tree_t, r: tree_t)
+{
+    val hl = height_(l), hr = height_(r)
+    if hl > hr + 1 {
+        match l {
+        | Node {left=ll, right=lr} =>
+            if height_(ll) >= height_(lr) {node_(ll, node_(lr, r))}
+            else {
+                match lr {
+                | Node {left=lrl, right=lrr} => node_(node_(ll, lrl), node_(lrr, r))
+                | _ => node_(l, r)
+                }
+            }
+        | _ => node_(l, r)
+        }
+    } else if hr > hl + 1 {
+        match r {
+        | Node {left=rl, right=rr} =>
+            if height_(rr) >= height_(rl) {node_(node_(l, rl), rr)}
+            else {
+                match rl {
+                | Node {left=rll, right=rlr} => node_(node_(l, rll), node_(rlr, rr))
+                | _ => node_(l, r)
+                }
+            }
+        | _ => node_(l, r)
+        }
+    } else {
+        node_(l, r)
+    }
+}
+
+@private fun concat_(l: tree_t, r: tree_t): tree_t
+{
+    val hl = height_(l), hr = height_(r)
+    match (l, r) {
+    | (Empty, _) => r
+    | (_, Empty) => l
+    | (Leaf(a), Leaf(b)) when a.length() + b.length() <= MAX_MERGED_CHUNK => Leaf(a + b)
+    | (Node {left=ll, right=lr}, _) when hl > hr + 1 => balance_(ll, concat_(lr, r))
+    | (_, Node {left=rl, right=rr}) when hr > hl + 1 => balance_(concat_(l, rl), rr)
+    | _ => node_(l, r)
+    }
+}
+
+// splits the tree into [0, i) and [i, length) parts
+@private fun split_(t: tree_t, i: int): (tree_t, tree_t) =
+    match t {
+    | Empty => (Empty, Empty)
+    | Leaf(s) =>
+        if i <= 0 {(Empty, t)}
+        else if i >= s.length() {(t, Empty)}
+        else {(Leaf(s[:i]), Leaf(s[i:]))}
+    | Node {left, right} =>
+        val nl = length_(left)
+        if i < nl {
+            val (a, b) = split_(left, i)
+            (a, concat_(b, right))
+        } else if i > nl {
+            val (a, b) = split_(right, i - nl)
+            (concat_(left, a), b)
+        } else {
+            (left, right)
+        }
+    }
+
+fun empty(): Rope.t = t {root=Empty}
+fun from_string(s: string): Rope.t = t {root=leaf_(s)}
+
+fun length(r: Rope.t) = length_(r.root)
+fun empty(r: Rope.t) = length_(r.root) == 0
+
+operator + (a: Rope.t, b: Rope.t): Rope.t = t {root=concat_(a.root, b.root)}
+operator + (a: Rope.t, s: string): Rope.t = t {root=concat_(a.root, leaf_(s))}
+
+// returns r[i:j]; the indices are clipped like in the case of string slicing
+fun slice(r: Rope.t, i: int, j: int): Rope.t
+{
+    val n = length(r)
+    val i = min(max(i, 0), n), j = min(max(j, i), n)
+    val (_, b) = split_(r.root, i)
+    val (c, _) = split_(b, j - i)
+    t {root=c}
+}
+
+fun insert(r: Rope.t, i: int, s: string): Rope.t
+{
+    val (a, b) = split_(r.root, i)
+    t {root=concat_(concat_(a, leaf_(s)), b)}
+}
+
+// removes r[i:j]
+fun remove(r: Rope.t, i: int, j: int): Rope.t
+{
+    val n = length(r)
+    val i = min(max(i, 0), n), j = min(max(j, i), n)
+    val (a, b) = split_(r.root, i)
+    val (_, c) = split_(b, j - i)
+    t {root=concat_(a, c)}
+}
+
+fun at(r: Rope.t, i: int): char
+{
+    fun at_(t: tree_t, i: int): char =
+        match t {
+        | Leaf(s) => s[i]
+        | Node {left, right} =>
+            val nl = length_(left)
+            if i < nl {at_(left, i)} else {at_(right, i - nl)}
+        | _ => throw OutOfRangeError
+        }
+    if i < 0 || i >= length(r) {throw OutOfRangeError}
+    at_(r.root, i)
+}
+
+// calls 'f' for each chunk of the rope, from left to right
+fun app_chunks(r: Rope.t, f: string -> void): void
+{
+    fun app_(t: tree_t): void =
+        match t {
+        | Leaf(s) => f(s)
+        | Node {left, right} => app_(left); app_(right)
+        | _ => {}
+        }
+    app_(r.root)
+}
+
+fun app(r: Rope.t, f: char -> void): void =
+    app_chunks(r, fun (s) {for c <- s {f(c)}})
+
+fun chunks(r: Rope.t): string list
+{
+    fun chunks_(t: tree_t, tail: string list): string list =
+        match t {
+        | Leaf(s) => s :: tail
+        | Node {left, right} => chunks_(left, chunks_(right, tail))
+        | _ => tail
+        }
+    chunks_(r.root, [])
+}
+
+fun string(r: Rope.t): string = join("", chunks(r))
+fun print(r: Rope.t) = print(string(r))
+
+operator == (a: Rope.t, b: Rope.t) = length(a) == length(b) && string(a) == string(b)
@@ -147,47 +147,8 @@
     return fx_status;
 }
 
-@pure fun tolower(s: string): string
-@ccode {
-    int_ i, sz = s->length;
-    const char_* src = s->data;
-    for (i = 0; i < sz; i++ ) {
-        char_ c = src[i];
-        if (fx_tolower(c) != c) break;
-    }
-    if (i == sz) {
-        fx_copy_str(s, fx_result);
-        return FX_OK;
-    }
-    int fx_status = fx_make_str(0, sz, fx_result);
-    if( fx_status >= 0 ) {
-        char_* dst = fx_result->data;
-        for (int_ i = 0; i < sz; i++)
-            dst[i] = fx_tolower(src[i]);
-    }
-    return fx_status;
-}
-
-@pure fun toupper(s: string): string
-@ccode {
-    int_ i, sz = s->length;
-    const char_* src = s->data;
-    for (i = 0; i < sz; i++ ) {
-        char_ c = src[i];
-        if (fx_toupper(c) != c) break;
-    }
-    if (i == sz) {
-        fx_copy_str(s, fx_result);
-        return FX_OK;
-    }
-    int fx_status = fx_make_str(0, sz, fx_result);
-    if( fx_status >= 0 ) {
-        char_* dst = fx_result->data;
-        for (int_ i = 0; i < sz; i++)
-            dst[i] = fx_toupper(src[i]);
-    }
-    return fx_status;
-}
+@pure fun tolower(s: string): string = @ccode { return fx_str_tolower(s, fx_result) }
+@pure fun toupper(s: string): string = @ccode { return fx_str_toupper(s, fx_result) }
 
 @pure fun capitalize(s: string): string
 @ccode {
@@ -227,11 +188,8 @@
 
 @pure fun lstrip(s: string): string
 @ccode {
-    const char_* ptr = s->data;
-    int_ i = 0, sz = s->length;
-    for (; i < sz && fx_isspace(ptr[i]); i++)
-        ;
-    return fx_substr(s, i, sz, 1, 0, fx_result);
+    int_ i = fx_str_skipspace(s->data, 0, s->length, false);
+    return fx_substr(s, i, s->length, 1, 0, fx_result);
 }
 
 @pure fun rstrip(s: string): string
@@ -246,9 +204,7 @@
 @pure fun strip(s: string): string
 @ccode {
     const char_* ptr = s->data;
-    int_ i = 0, sz = s->length;
-    for (; i < sz && fx_isspace(ptr[i]); i++)
-        ;
+    int_ sz = s->length, i = fx_str_skipspace(ptr, 0, sz, false);
     for (; sz > i && fx_isspace(ptr[sz - 1]); sz--)
         ;
     return fx_substr(s, i, sz, 1, 0, fx_result);
@@ -266,16 +222,80 @@ fun tokens(s: string, f: char->bool)
     (if sep {sl} else {s[start:] :: sl}).rev()
 }
 
-fun split(s: string, c: char, ~allow_empty:bool)
+// splits the string into the whitespace-separated tokens
+fun tokens(s: string): string list
+{
+    @pure fun tokens_(s: string): (int, int) [] =
+    @ccode { return fx_str_tokens_space(s, fx_result) }
+    [for (i, j) <- tokens_(s) {s[i:j]}]
+}
+
+fun split(s: string, c: char, ~allow_empty:bool) =
+    [for field <- split_array(s, c, allow_empty=allow_empty) {field}]
+
+// same as split(), but returns array.
+// The fields are not copied, they share the buffer with the original string
+fun split_array(s: string, c: char, ~allow_empty:bool): string []
+{
+    @pure fun split_(s: string, c: char, allow_empty: bool): string [] =
+    @ccode { return fx_str_split(s, c, allow_empty, fx_result) }
+    split_(s, c, allow_empty)
+}
+
+// calls 'f' for each field of the string, separated by 'c',
+// without constructing the list or array of fields
+fun split_iter(s: string, c: char, f: string->void, ~allow_empty:bool): void
 {
-    val fold (sl, start, sep) = ([], 0, true) for ci@i <- s {
+    var start = 0, sep = true
+    for ci@i <- s {
         if ci == c {
-            (if sep && !allow_empty {sl} else {s[start:i] :: sl}, i+1, true)
-        } else {
-            (sl, if sep {i} else {start}, false)
+            if !sep || allow_empty {f(s[start:i])}
+            start = i+1
+            sep = true
+        } else if sep {
+            start = i
+            sep = false
         }
     }
-    (if sep {sl} else {s[start:] :: sl}).rev()
+    if !sep {f(s[start:])}
+}
+
+// calls 'g' for each token of the string, separated by the characters, for which 'f' returns true,
+// without constructing the list or array of tokens
+fun tokens_iter(s: string, f: char->bool, g: string->void): void
+{
+    var start = 0, sep = true
+    for c@i <- s {
+        if f(c) {
+            if !sep {g(s[start:i])}
+            sep = true
+        } else if sep {
+            start = i
+            sep = false
+        }
+    }
+    if !sep {g(s[start:])}
+}
+
+// same as tokens(s, f), but returns array
+fun tokens_array(s: string, f: char->bool): string []
+{
+    val sep = [| for c <- s {f(c)} |]
+    val n = fold n = 0 for sepi@i <- sep {
+        if !sepi && (i == 0 || sep[i-1]) {n + 1} else {n}
+    }
+    val result = array(n, "")
+    var k = 0, start = 0
+    for sepi@i <- sep {
+        if !sepi {
+            if i == 0 || sep[i-1] {start = i}
+        } else if i > 0 && !sep[i-1] {
+            result[k] = s[start:i]
+            k += 1
+        }
+    }
+    if k < n {result[k] = s[start:]}
+    result
 }
 
 @nothrow fun to_int(a: string): int?
@@ -303,6 +323,16 @@ fun split(s: string, c: char, ~allow_empty:bool)
     return ok ? result : defval;
 }
 
+// parses the decimal integers, separated by 'sep' and/or whitespaces;
+// throws BadArgError if some of the numbers cannot be parsed
+fun parse_ints(s: string, sep: char): int [] =
+@ccode { return fx_str_parse_ints(s, sep, fx_result) }
+
+// parses the floating-point numbers, separated by 'sep' and/or whitespaces;
+// throws BadArgError if some of the numbers cannot be parsed
+fun parse_doubles(s: string, sep: char): double [] =
+@ccode { return fx_str_parse_doubles(s, sep, fx_result) }
+
 fun num_suffix(n: int) =
     match n % 10 {
     | 1 => "st"
@@ -11,8 +11,14 @@ import File, Filename
     #include <stdlib.h>
     #include <stdio.h>
     #include <sys/stat.h>
-#if !defined WIN32 && !defined _WIN32
+#if defined WIN32 || defined _WIN32
+    #include <windows.h>
+#else
     #include <unistd.h>
+    #include <errno.h>
+    #include <spawn.h>
+    #include <sys/wait.h>
+    extern char** environ;
 #endif
 
     #ifndef PATH_MAX
@@ -83,6 +89,22 @@ fun arguments() = argv.tl()
 
 @pure @nothrow fun tick_count(): int64 = @ccode { return fx_tick_count() }
 @pure @nothrow fun tick_frequency(): double = @ccode { return fx_tick_frequency() }
+// enables/disables counting of the allocated memory; it's disabled by default,
+// because it adds some overhead to each allocation
+@nothrow fun enable_alloc_stat(enable: bool): void = @ccode { fx_enable_alloc_stat(enable) }
+// the approximate number of bytes allocated by the program (in all the threads)
+// while the counting was enabled, see enable_alloc_stat()
+@nothrow fun allocated_bytes(): int64 = @ccode { return fx_allocated_bytes() }
+
+// suspends the current thread for the specified number of milliseconds
+@nothrow fun sleep(ms: int): void = @ccode {
+#if defined _WIN32 || defined WINCE
+    Sleep((DWORD)ms);
+#else
+    usleep((useconds_t)(ms*1000));
+#endif
+    return;
+}
 
 fun timeit(f: void -> void, ~iterations: int=1, ~batch: int=1): double
 {
@@ -153,6 +175,131 @@ fun command(cmd: string): int = @ccode {
     return fx_status;
 }
 
+// the number of online CPU cores
+@nothrow fun ncpus(): int = @ccode {
+    int_ n = 1;
+#if defined _WIN32 || defined WINCE
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    n = (int_)info.dwNumberOfProcessors;
+#else
+    n = (int_)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return n > 0 ? n : 1;
+}
+
+// the average number of runnable processes over the last minute or -1 if it's not available
+@nothrow fun loadavg(): double = @ccode {
+    double avg = -1.;
+#if !defined _WIN32 && !defined WINCE
+    if (getloadavg(&avg, 1) != 1)
+        avg = -1.;
+#endif
+    return avg;
+}
+
+// starts the command without waiting for it to finish and returns the process id.
+// Unlike command(), the shell is not involved unless the command
+// contains shell special characters: redirections, pipes, variables etc.
+fun spawn(cmd: string): int = @ccode {
+#if defined _WIN32 || defined WINCE
+    int fx_status = FX_SET_EXN_FAST(FX_EXN_NotImplementedError);
+#else
+    fx_cstr_t cmd_;
+    int fx_status = fx_str2cstr(cmd, &cmd_, 0, 0);
+    if (fx_status >= 0) {
+        char* buf = (char*)fx_malloc(cmd_.length + 1);
+        char** args = (char**)fx_malloc((cmd_.length/2 + 4)*sizeof(args[0]));
+        char* sh_args[] = {(char*)"/bin/sh", (char*)"-c", cmd_.data, 0};
+        bool use_shell = strpbrk(cmd_.data, "|&;<>()$`*?[]#~\n") != 0;
+        int nargs = 0, err;
+        pid_t pid = 0;
+        if (!buf || !args)
+            fx_status = FX_SET_EXN_FAST(FX_EXN_OutOfMemError);
+        else if (!use_shell) {
+            // split the command into arguments, handle quotes and backslashes
+            const char* ptr = cmd_.data;
+            char* dst = buf;
+            for(;;) {
+                char quote = 0;
+                while (*ptr == ' ' || *ptr == '\t') ptr++;
+                if (*ptr == '\0') break;
+                args[nargs++] = dst;
+                for (; *ptr != '\0'; ptr++) {
+                    char c = *ptr;
+                    if (quote == 0 && (c == ' ' || c == '\t')) break;
+                    if (c == quote) quote = 0;
+                    else if (quote == 0 && (c == '\'' || c == '"')) quote = c;
+                    else if (c == '\\' && quote != '\'' && ptr[1] != '\0') *dst++ = *++ptr;
+                    else *dst++ = c;
+                }
+                *dst++ = '\0';
+            }
+            args[nargs] = 0;
+        }
+        if (fx_status >= 0) {
+            char** argv = use_shell || nargs == 0 ? sh_args : args;
+            err = posix_spawnp(&pid, argv[0], 0, 0, argv, environ);
+            if (err != 0)
+                fx_status = FX_SET_EXN_FAST(FX_EXN_IOError);
+            else
+                *fx_result = (int_)pid;
+        }
+        fx_free(args);
+        fx_free(buf);
+        fx_free_cstr(&cmd_);
+    }
+#endif
+    return fx_status;
+}
+
+// waits for any of the specified processes, started with spawn(), to finish.
+// Returns the process id and the exit code (or -1 if the process has been terminated by a signal).
+// Other child processes of the application are not affected
+fun wait_any(pids: int []): (int, int) = @ccode {
+    int fx_status = FX_OK;
+#if defined _WIN32 || defined WINCE
+    fx_status = FX_SET_EXN_FAST(FX_EXN_NotImplementedError);
+#else
+    const int_* pids_ = (const int_*)pids->data;
+    int_ i, npids = pids->data ? pids->dim[0].size : 0;
+    for (;;) {
+        int status = 0, nvalid = 0;
+        siginfo_t info;
+        pid_t pid = 0;
+        for (i = 0; i < npids; i++) {
+            pid = waitpid((pid_t)pids_[i], &status, WNOHANG);
+            if (pid == (pid_t)pids_[i])
+                break;
+            nvalid += pid == 0 || errno != ECHILD;
+        }
+        if (i < npids) {
+            fx_result->t0 = (int_)pid;
+            fx_result->t1 = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+            break;
+        }
+        if (nvalid == 0) {
+            fx_status = FX_SET_EXN_FAST(FX_EXN_NotFoundError);
+            break;
+        }
+        /* wait until some child process finishes, but leave it in the waitable state.
+           If it's not one of 'pids', it will be collected by the code that started it;
+           meanwhile we poll our processes periodically */
+        memset(&info, 0, sizeof(info));
+        if (waitid(P_ALL, 0, &info, WEXITED | WNOWAIT) < 0 && errno != EINTR) {
+            fx_status = FX_SET_EXN_FAST(FX_EXN_NotFoundError);
+            break;
+        }
+        for (i = 0; i < npids; i++)
+            if (info.si_pid == (pid_t)pids_[i])
+                break;
+        if (i == npids)
+            usleep(1000);
+    }
+#endif
+    return fx_status;
+}
+
 fun getenv(name: string): string = @ccode {
     fx_cstr_t name_;
     int fx_status = fx_str2cstr(name, &name_, 0, 0);
@@ -147,6 +147,10 @@ char* fx_argv(int_ idx);
 void* fx_malloc(size_t sz);
 void* fx_realloc(void* ptr, size_t sz);
 void fx_free(void* ptr);
+// enables/disables counting of the bytes allocated with fx_malloc() and fx_realloc()
+void fx_enable_alloc_stat(bool enable);
+// the approximate total number of bytes allocated while the counting was enabled
+int64_t fx_allocated_bytes(void);
 
 #define FX_DECL_AND_MALLOC(ptrtyp, ptr) \
     ptrtyp ptr = (ptrtyp)fx_malloc(sizeof(*ptr)); \
@@ -462,6 +466,9 @@ bool fx_isspace(char_ ch);
 char_ fx_tolower(char_ ch);
 char_ fx_toupper(char_ ch);
 int fx_todigit(char_ ch);
+int fx_str_tolower(const fx_str_t* src, fx_str_t* dst);
+int fx_str_toupper(const fx_str_t* src, fx_str_t* dst);
+int_ fx_str_skipspace(const char_* ptr, int_ start, int_ len, bool space);
 int fx_bidirectional(char_ ch);
 bool fx_atoi(const fx_str_t* str, int_* result, int base);
 bool fx_atof(const fx_str_t* str, double* result);
@@ -908,6 +915,10 @@ int fx_compose_arr( int dims, size_t elemsize, fx_free_t free_elem, fx_copy_t co
                     const int8_t* tags, const void** data, fx_arr_t* arr );
 int fx_subarr(const fx_arr_t* arr, const int_* ranges, fx_arr_t* result);
 int fx_flatten_arr(const fx_arr_t* arr, fx_arr_t* farr);
+int fx_str_tokens_space(const fx_str_t* str, fx_arr_t* result);
+int fx_str_split(const fx_str_t* str, char_ c, bool allow_empty, fx_arr_t* result);
+int fx_str_parse_ints(const fx_str_t* str, char_ sep, fx_arr_t* result);
+int fx_str_parse_doubles(const fx_str_t* str, char_ sep, fx_arr_t* result);
 int fx_gemm(fx_arr_t* m1, bool t1, int_ rs1, int_ re1, int_ rd1, int_ cs1, int_ ce1, int_ cd1,
             fx_arr_t* m2, bool t2, int_ rs2, int_ re2, int_ rd2, int_ cs2, int_ ce2, int_ cd2, fx_arr_t* result);
 
@@ -1012,6 +1023,15 @@ int fx_rrb_slice(const fx_rrbvec_t* vec, int_ start, int_ end, int delta, int ma
     *fx_result = r; \
     return FX_OK
 
+/* the reference cell that does not escape the current block is put on stack.
+   the owner never decrements the counter, so the cell is never passed to fx_free;
+   the data is released separately in the end of the block */
+#define FX_MAKE_REF_ON_STACK(cell, dest) \
+    do { \
+        (cell).rc = 1; \
+        (dest) = &(cell); \
+    } while(0)
+
 void fx_free_ref_simple(void* pr);
 #define FX_FREE_REF_SIMPLE(pr) if(!*(pr)) ; else fx_free_ref_simple(pr)
 
@@ -1057,6 +1077,17 @@ typedef struct fx_fcv_t
    if((dest).fcv && (dest).fcv->free_f) \
       FX_INCREF((dest).fcv->rc)
 
+/* the closure data of the closure that does not escape the current block is put on stack.
+   free_f=0 disables reference counting of such closure data, just like for the functions
+   without free variables; the captured values are released separately in the end of the block */
+#define FX_MAKE_FP_ON_STACK(fname, fcv_data, dest) \
+    do { \
+        (fcv_data).rc = 1; \
+        (fcv_data).free_f = 0; \
+        (dest).fp = (fname); \
+        (dest).fcv = (fx_fcv_t*)&(fcv_data); \
+    } while(0)
+
 void fx_free_fp(void* fp);
 void fx_copy_fp(const void* src, void* pdst);
 
@@ -1136,6 +1167,19 @@ fx_cptr_t fx_get_stdstream(int);
 
 int64_t fx_tick_count(void);
 double fx_tick_frequency(void);
+void fx_spin_lock(int_* lock);
+void fx_spin_unlock(int_* lock);
+void fx_spin_lock_shared(int_* lock);
+void fx_spin_unlock_shared(int_* lock);
+void fx_spin_lock_exclusive(int_* lock);
+void fx_spin_unlock_exclusive(int_* lock);
+void fx_prof_dump(const char* filename, int n, const char** keys, const uint64_t* counts);
+// increments the profile counter (-pgo-gen); the instrumented functions may run in several threads
+#ifdef _MSC_VER
+#define FX_PROF_INC(counter) _InterlockedIncrement64((__int64 volatile*)&(counter))
+#else
+#define FX_PROF_INC(counter) __atomic_fetch_add(&(counter), 1, __ATOMIC_RELAXED)
+#endif
 
 ////////////////////////// Regular expressions /////////////////////
 
@@ -1149,6 +1193,7 @@ enum
     FX_RE_FIND_MODE_ = 1<<16,
     FX_RE_FINDALL_MODE_ = 2<<16,
     FX_RE_MODE_MASK_ = 7<<16,
+    FX_RE_PREFILTERED_ = 8<<16,
 };
 
 int fx_re_compile(const fx_str_t* str, fx_cptr_t* fx_result);
@@ -1157,6 +1202,10 @@ int fx_re_match(const fx_cptr_t regex, const fx_str_t* str, int flags, fx_arr_t*
 int fx_re_replace(const fx_cptr_t regex, const fx_str_t* str,
                   const fx_str_t* subst, int flags, fx_str_t* result);
 
+int fx_mm_compile(const fx_arr_t* patterns, fx_cptr_t* fx_result);
+int fx_mm_find(const fx_cptr_t mm, const void* data, int elemsize, int_ len,
+               bool first_only, fx_arr_t* fx_result);
+
 #ifdef __cplusplus
 }
 #endif
@@ -14,6 +14,7 @@
     #define FX_UNIX 1
     #include <unistd.h>
     #include <time.h>
+    #include <sched.h>
     #include <execinfo.h>
     #if defined __MACH__ && defined __APPLE__
     #include <mach/mach.h>
@@ -190,12 +191,43 @@ int fx_cc_version(struct fx_str_t* ver)
 
 static FX_THREAD_LOCAL volatile bool fx_rpmalloc_thread_initialized = false;
 
+// the number of allocated bytes is accumulated in a thread-local counter,
+// which is added to the global counter once it exceeds FX_ALLOC_STAT_BATCH,
+// so that the atomic operation is not performed on each allocation.
+// The counting is disabled by default
+enum { FX_ALLOC_STAT_BATCH = 1 << 16 };
+static bool fx_alloc_stat_enabled = false;
+static int_ fx_total_allocated = 0;
+static FX_THREAD_LOCAL int_ fx_thread_allocated = 0;
+
+static void fx_count_alloc(size_t sz)
+{
+    int_ allocated = fx_thread_allocated + (int_)sz;
+    if (allocated >= FX_ALLOC_STAT_BATCH) {
+        FX_XADD(&fx_total_allocated, allocated);
+        allocated = 0;
+    }
+    fx_thread_allocated = allocated;
+}
+
+void fx_enable_alloc_stat(bool enable)
+{
+    fx_alloc_stat_enabled = enable;
+}
+
+int64_t fx_allocated_bytes(void)
+{
+    return (int64_t)fx_total_allocated + fx_thread_allocated;
+}
+
 void* fx_malloc(size_t sz)
 {
     if (!fx_rpmalloc_thread_initialized) {
         rpmalloc_thread_initialize();
         fx_rpmalloc_thread_initialized = true;
     }
+    if (fx_alloc_stat_enabled)
+        fx_count_alloc(sz);
     return rpmalloc(sz);
 }
 
@@ -205,6 +237,12 @@ void* fx_realloc(void* ptr, size_t sz)
         rpmalloc_thread_initialize();
         fx_rpmalloc_thread_initialized = true;
     }
+    // only the growth of the block is counted, since the old block has already been counted
+    if (fx_alloc_stat_enabled) {
+        size_t old_sz = ptr ? rpmalloc_usable_size(ptr) : 0;
+        if (sz > old_sz)
+            fx_count_alloc(sz - old_sz);
+    }
     return rprealloc(ptr, sz);
 }
 
@@ -758,6 +796,7 @@ int fx_make_cptr(void* ptr, fx_free_t free_f, fx_cptr_t* fx_result)
 #include "ficus/impl/file.impl.h"
 #include "ficus/impl/string.impl.h"
 #include "ficus/impl/regex.impl.h"
+#include "ficus/impl/multimatch.impl.h"
 #include "ficus/impl/system.impl.h"
 #include "ficus/impl/rrbvec.impl.h"
 #include "ficus/impl/rpmalloc.impl.h"
@@ -0,0 +1,312 @@
+/*
+    This file is a part of ficus language project.
+    See ficus/LICENSE for the licensing terms
+*/
+
+/*
+    Multiple string matching using Aho-Corasick algorithm.
+
+    All the patterns are compiled into a trie with failure links,
+    and then all the occurrences of all the patterns are found
+    in a single pass over the text.
+
+    The characters that occur in the patterns are mapped to the small
+    set of character classes (class 0 means 'any other character').
+    If the number of states times the number of classes is not too big,
+    the trie is converted into the dense DFA, i.e. the table
+    of transitions for each state and each class, so that each text character
+    is processed with a single table lookup. Otherwise the trie
+    and the failure links are used directly.
+
+    Since the matches can only start with the characters that
+    the patterns start with, while the automaton is in the initial state,
+    the text is quickly scanned for such a character (the prefilter).
+
+    The compiled automaton is never modified after construction,
+    so it can be used from several threads simultaneously.
+*/
+
+#ifndef __FICUS_MULTIMATCH_IMPL_H__
+#define __FICUS_MULTIMATCH_IMPL_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum
+{
+    FX_MM_NASCII = 128,
+    FX_MM_MAX_DENSE = 1 << 24,
+    FX_MM_BUFSIZE = 256
+};
+
+typedef struct fx_mm_t
+{
+    int nstates, nclasses, npatterns;
+    int asciiclass[FX_MM_NASCII];
+    int nextchars;
+    char_* extchars;    // sorted non-ASCII characters that occur in the patterns
+    int* extclass;      // and their classes
+    int* child;         // the trie: the first child of each state or -1,
+    int* sibling;       // the next sibling or -1,
+    int* label;         // and the class of the edge from the parent
+    int* fail;          // failure links
+    int* dict;          // the nearest state in the failure chain, where some pattern ends, or -1
+    int* term;          // the first pattern that ends in the state or -1
+    int* samenext;      // for each pattern: the next pattern with the same text or -1
+    int* patlen;
+    int* delta;         // nstates x (nclasses+1) transitions of the dense DFA or 0
+    bool prefilter[FX_MM_NASCII]; // ASCII characters that may start a match
+    bool prefilter_ext; // true if some of the patterns start with non-ASCII character
+} fx_mm_t;
+
+static void fx_mm_free(void* ptr)
+{
+    fx_mm_t* mm = (fx_mm_t*)ptr;
+    if(mm) {
+        fx_free(mm->extchars);
+        fx_free(mm->extclass);
+        fx_free(mm->child);
+        fx_free(mm->delta);
+        fx_free(mm);
+    }
+}
+
+static int fx_mm_class_(const fx_mm_t* mm, char_ c)
+{
+    int a = 0, b = mm->nextchars - 1;
+    if(c < FX_MM_NASCII)
+        return mm->asciiclass[c];
+    while(a <= b) {
+        int m = (a + b)/2;
+        char_ cm = mm->extchars[m];
+        if(cm == c) return mm->extclass[m];
+        if(cm < c) a = m + 1; else b = m - 1;
+    }
+    return 0;
+}
+
+static int fx_mm_goto_(const fx_mm_t* mm, int s, int cls)
+{
+    int st = mm->child[s];
+    for(; st >= 0; st = mm->sibling[st])
+        if(mm->label[st] == cls)
+            break;
+    return st;
+}
+
+static int fx_mm_cmpchars_(const void* a, const void* b)
+{
+    char_ ca = *(const char_*)a, cb = *(const char_*)b;
+    return (ca > cb) - (ca < cb);
+}
+
+int fx_mm_compile(const fx_arr_t* patterns, fx_cptr_t* fx_result)
+{
+    const fx_str_t* strs = (const fx_str_t*)patterns->data;
+    int_ i, j, npatterns = patterns->dim[0].size, total = 0, nextchars = 0;
+    int nclasses = 0, nstates = 1, maxstates, qhead = 0, qtail = 0;
+    int* queue;
+    fx_mm_t* mm;
+    if(patterns->ndims != 1)
+        FX_FAST_THROW_RET(FX_EXN_DimError);
+    for(i = 0; i < npatterns; i++) {
+        if(strs[i].length == 0)
+            FX_FAST_THROW_RET(FX_EXN_BadArgError);
+        total += strs[i].length;
+    }
+    if(total >= INT_MAX/2)
+        FX_FAST_THROW_RET(FX_EXN_SizeError);
+    maxstates = (int)total + 1;
+    mm = (fx_mm_t*)fx_malloc(sizeof(*mm));
+    if(!mm)
+        FX_FAST_THROW_RET(FX_EXN_OutOfMemError);
+    memset(mm, 0, sizeof(*mm));
+    mm->npatterns = (int)npatterns;
+    mm->extchars = (char_*)fx_malloc((total + 1)*sizeof(mm->extchars[0]));
+    mm->extclass = (int*)fx_malloc((total + 1)*sizeof(mm->extclass[0]));
+    // all the per-state and per-pattern arrays are stored in a single buffer
+    mm->child = (int*)fx_malloc(((size_t)maxstates*8 + npatterns*2 + 1)*sizeof(int));
+    if(!mm->extchars || !mm->extclass || !mm->child) {
+        fx_mm_free(mm);
+        FX_FAST_THROW_RET(FX_EXN_OutOfMemError);
+    }
+    mm->sibling = mm->child + maxstates;
+    mm->label = mm->sibling + maxstates;
+    mm->fail = mm->label + maxstates;
+    mm->dict = mm->fail + maxstates;
+    mm->term = mm->dict + maxstates;
+    queue = mm->term + maxstates;
+    mm->samenext = queue + maxstates*2;
+    mm->patlen = mm->samenext + npatterns;
+
+    // assign classes to the characters
+    for(i = 0; i < npatterns; i++) {
+        for(j = 0; j < strs[i].length; j++) {
+            char_ c = strs[i].data[j];
+            if(c < FX_MM_NASCII) {
+                if(mm->asciiclass[c] == 0)
+                    mm->asciiclass[c] = ++nclasses;
+            } else
+                mm->extchars[nextchars++] = c;
+        }
+    }
+    if(nextchars > 0) {
+        qsort(mm->extchars, (size_t)nextchars, sizeof(mm->extchars[0]), fx_mm_cmpchars_);
+        for(i = j = 0; i < nextchars; i++) {
+            if(j > 0 && mm->extchars[j-1] == mm->extchars[i])
+                continue;
+            mm->extchars[j] = mm->extchars[i];
+            mm->extclass[j++] = ++nclasses;
+        }
+        nextchars = j;
+    }
+    mm->nextchars = (int)nextchars;
+    mm->nclasses = nclasses;
+
+    // build the trie; the patterns are added in the reverse order,
+    // so that the duplicates are reported in the original order
+    mm->child[0] = mm->sibling[0] = mm->term[0] = -1;
+    mm->label[0] = 0;
+    for(i = npatterns - 1; i >= 0; i--) {
+        int s = 0;
+        for(j = 0; j < strs[i].length; j++) {
+            int cls = fx_mm_class_(mm, strs[i].data[j]);
+            int st = fx_mm_goto_(mm, s, cls);
+            if(st < 0) {
+                st = nstates++;
+                mm->child[st] = mm->term[st] = -1;
+                mm->sibling[st] = mm->child[s];
+                mm->label[st] = cls;
+                mm->child[s] = st;
+            }
+            s = st;
+        }
+        mm->samenext[i] = mm->term[s];
+        mm->term[s] = (int)i;
+        mm->patlen[i] = (int)strs[i].length;
+    }
+    mm->nstates = nstates;
+
+    // compute the failure links in the breadth-first order
+    mm->fail[0] = 0;
+    mm->dict[0] = -1;
+    queue[qtail++] = 0;
+    while(qhead < qtail) {
+        int s = queue[qhead++];
+        for(int st = mm->child[s]; st >= 0; st = mm->sibling[st]) {
+            int cls = mm->label[st], f = mm->fail[s], g;
+            for(;;) {
+                g = fx_mm_goto_(mm, f, cls);
+                if(g >= 0 || f == 0)
+                    break;
+                f = mm->fail[f];
+            }
+            f = g >= 0 && g != st ? g : 0;
+            mm->fail[st] = f;
+            mm->dict[st] = mm->term[f] >= 0 ? f : mm->dict[f];
+            queue[qtail++] = st;
+        }
+    }
+
+    // the prefilter
+    for(int st = mm->child[0]; st >= 0; st = mm->sibling[st]) {
+        int cls = mm->label[st];
+        for(int c = 0; c < FX_MM_NASCII; c++)
+            if(mm->asciiclass[c] == cls)
+                mm->prefilter[c] = true;
+        for(i = 0; i < nextchars; i++)
+            if(mm->extclass[i] == cls)
+                mm->prefilter_ext = true;
+    }
+
+    // convert the trie into the dense DFA, if it's not too big
+    if((size_t)nstates*(nclasses + 1) <= FX_MM_MAX_DENSE) {
+        int nc1 = nclasses + 1;
+        int* delta = (int*)fx_malloc((size_t)nstates*nc1*sizeof(delta[0]));
+        if(delta) {
+            // since the states are processed in the breadth-first order,
+            // the transitions of the failure state are always computed already
+            for(i = 0; i < nstates; i++) {
+                int s = queue[i];
+                for(int cls = 0; cls < nc1; cls++) {
+                    int g = fx_mm_goto_(mm, s, cls);
+                    delta[s*nc1 + cls] = g >= 0 ? g : s == 0 ? 0 : delta[mm->fail[s]*nc1 + cls];
+                }
+            }
+            mm->delta = delta;
+        }
+    }
+    return fx_make_cptr(mm, fx_mm_free, fx_result);
+}
+
+// finds all the occurrences of the patterns in the text, which is either UTF-32 string
+// or byte string (elemsize == 1). The result is the array of (pattern index, start position) pairs
+int fx_mm_find(const fx_cptr_t mm_, const void* data, int elemsize, int_ len,
+               bool first_only, fx_arr_t* fx_result)
+{
+    const fx_mm_t* mm = mm_ ? (const fx_mm_t*)mm_->ptr : 0;
+    const uint8_t* data8 = (const uint8_t*)data;
+    const char_* data32 = (const char_*)data;
+    int_ buf[FX_MM_BUFSIZE*2], *matches = buf, bufsz = FX_MM_BUFSIZE, nmatches = 0;
+    int_ j = 0;
+    int s = 0, nc1, fx_status;
+    if(!mm)
+        FX_FAST_THROW_RET(FX_EXN_NullPtrError);
+    nc1 = mm->nclasses + 1;
+    while(j < len) {
+        char_ c = elemsize == 1 ? data8[j] : data32[j];
+        int cls, t;
+        if(s == 0) {
+            // skip the characters that cannot start a match
+            while(c < FX_MM_NASCII ? !mm->prefilter[c] : !mm->prefilter_ext) {
+                if(++j >= len)
+                    break;
+                c = elemsize == 1 ? data8[j] : data32[j];
+            }
+            if(j >= len)
+                break;
+        }
+        cls = fx_mm_class_(mm, c);
+        if(mm->delta)
+            s = mm->delta[s*nc1 + cls];
+        else {
+            for(;;) {
+                int g = fx_mm_goto_(mm, s, cls);
+                if(g >= 0) { s = g; break; }
+                if(s == 0) break;
+                s = mm->fail[s];
+            }
+        }
+        j++;
+        for(t = mm->term[s] >= 0 ? s : mm->dict[s]; t >= 0; t = mm->dict[t]) {
+            for(int p = mm->term[t]; p >= 0; p = mm->samenext[p]) {
+                if(nmatches >= bufsz) {
+                    int_* newmatches = (int_*)fx_malloc(bufsz*4*sizeof(newmatches[0]));
+                    if(!newmatches) {
+                        if(matches != buf) fx_free(matches);
+                        FX_FAST_THROW_RET(FX_EXN_OutOfMemError);
+                    }
+                    memcpy(newmatches, matches, nmatches*2*sizeof(matches[0]));
+                    if(matches != buf) fx_free(matches);
+                    matches = newmatches;
+                    bufsz *= 2;
+                }
+                matches[nmatches*2] = p;
+                matches[nmatches*2+1] = j - mm->patlen[p];
+                nmatches++;
+            }
+        }
+        if(first_only && nmatches > 0)
+            break;
+    }
+    fx_status = fx_make_arr(1, &nmatches, sizeof(int_)*2, 0, 0, matches, fx_result);
+    if(matches != buf) fx_free(matches);
+    return fx_status;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
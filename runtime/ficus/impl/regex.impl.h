@@ -21,6 +21,7 @@ extern "C" {
 #include <string.h>
 #include <stdarg.h>
 #include <assert.h>
+#include <limits.h>
 
 typedef struct fx_re_astnode_t
 {
@@ -94,10 +95,23 @@ typedef struct fx_re_inst_t
 	int gen;	// global state, oooh!
 } fx_re_inst_t;
 
+enum { FX_RE_MAXLIT = 32 };
+
 typedef struct fx_regex_t
 {
     fx_re_inst_t* prog;
     int len, nsub;
+    bool use_dfa;
+    // there are no alternatives (SPLIT instructions) besides the '.*?' prefix,
+    // so each string can be matched in at most one way
+    bool single_path;
+    // unique id of the compiled regexp; used to find the cached DFA
+    int_ id;
+    // the literal string that every match starts with and
+    // the longest literal string that every match contains
+    int prefixlen, factorlen;
+    char_ prefix[FX_RE_MAXLIT];
+    char_ factor[FX_RE_MAXLIT];
 } fx_regex_t;
 
 enum	/* fx_re_inst_t.opcode */
@@ -221,9 +235,13 @@ fx_re_decref_(fx_re_matcher_t* matcher, fx_re_sub_t *s)
 
 static int fx_re_count_(fx_re_ast_t*, int);
 static int fx_re_emit_(fx_re_inst_t* re, int, int*, fx_re_ast_t*, int);
+static void fx_re_litprefix_(const fx_re_ast_t*, int, char_*, int*, bool*);
+static void fx_re_litfactor_(const fx_re_ast_t*, int, fx_regex_t*, char_*, int*);
 
 ////////////////////// compile & interpret regexps /////////////////////////////
 
+static int_ fx_re_nextid_ = 0;
+
 static fx_regex_t* fx_re_compile_(fx_re_ast_t *ast)
 {
     int nsub = ast->grp*2;
@@ -237,6 +255,7 @@ static fx_regex_t* fx_re_compile_(fx_re_ast_t *ast)
     re->prog = (fx_re_inst_t*)(re + 1);
     re->len = len;
     re->nsub = nsub;
+    re->id = FX_XADD(&fx_re_nextid_, 1) + 1;
     memset(re->prog, 0, progsize);
 	int status = fx_re_emit_(re->prog, len, &pc, ast, ast->root);
     if (status >= 0) {
@@ -245,6 +264,26 @@ static fx_regex_t* fx_re_compile_(fx_re_ast_t *ast)
             return 0;
         }
         re->prog[pc-1].opcode = FX_RE_OP_MATCH;
+        // word boundary depends on the previous character,
+        // which DFA state does not keep track of
+        re->use_dfa = true;
+        re->single_path = true;
+        for(pc = 0; pc < len; pc++) {
+            if(re->prog[pc].opcode == FX_RE_OP_WBOUND)
+                re->use_dfa = false;
+            if(pc >= 3 && re->prog[pc].opcode == FX_RE_OP_SPLIT)
+                re->single_path = false;
+        }
+        // skip the '.*?' prefix and analyze the actual regexp
+        {
+        char_ run[FX_RE_MAXLIT];
+        int runlen = 0;
+        bool exact = false;
+        int root = ast->buf[ast->root].right;
+        re->prefixlen = re->factorlen = 0;
+        fx_re_litprefix_(ast, root, re->prefix, &re->prefixlen, &exact);
+        fx_re_litfactor_(ast, root, re, run, &runlen);
+        }
     }
     if (status < 0 && re) {
         fx_free(re);
@@ -254,6 +293,34 @@ static fx_regex_t* fx_re_compile_(fx_re_ast_t *ast)
     }
 }
 
+/*
+    When the same regexp is applied to many strings (e.g. to each line of a big file),
+    allocation of the matcher and DFA buffers on each call may take more time
+    than the actual matching. So the buffers are kept in the thread-local scratch area
+    and reused by subsequent calls. Since each thread has its own scratch area,
+    the regexps can be safely used inside @parallel for loops.
+*/
+enum
+{
+    FX_RE_SCRATCH_MAX_BUFSIZE = 1 << 20,
+    FX_RE_SCRATCH_NDFA = 4
+};
+
+struct fx_re_dfa_t;
+
+typedef struct fx_re_scratch_t
+{
+    char* matcherbuf;
+    size_t matcherbuf_size;
+    // a few DFAs for the recently used (regexp, flags) pairs
+    int_ dfa_id[FX_RE_SCRATCH_NDFA];
+    int dfa_flags[FX_RE_SCRATCH_NDFA];
+    struct fx_re_dfa_t* dfa[FX_RE_SCRATCH_NDFA];
+    int dfa_victim;
+} fx_re_scratch_t;
+
+static FX_THREAD_LOCAL fx_re_scratch_t fx_re_scratch_;
+
 // Inside findall or global replace functions,
 // when we found one match and want to move to the next one,
 // we need to reset the state.
@@ -289,9 +356,23 @@ static int fx_re_init_matcher(fx_re_matcher_t* matcher, const fx_str_t* input, c
     subbuf_capacity = (matcher->proglen*2 + 2)*subsize;
     total = pcgen_size + subbuf_capacity + threadbuf_size;
     //printf("total regexp matcher buf size=%d\n", (int)total);
-    matcher->globalbuf = bufptr = (char*)fx_malloc(total);
-    if(!matcher->globalbuf)
-        return FX_SET_EXN_FAST(FX_EXN_OutOfMemError);
+    if (total <= FX_RE_SCRATCH_MAX_BUFSIZE) {
+        fx_re_scratch_t* scratch = &fx_re_scratch_;
+        if (total > scratch->matcherbuf_size) {
+            fx_free(scratch->matcherbuf);
+            scratch->matcherbuf_size = 0;
+            scratch->matcherbuf = (char*)fx_malloc(total);
+            if(!scratch->matcherbuf)
+                return FX_SET_EXN_FAST(FX_EXN_OutOfMemError);
+            scratch->matcherbuf_size = total;
+        }
+        bufptr = scratch->matcherbuf;
+    } else {
+        // do not keep too big buffers around
+        matcher->globalbuf = bufptr = (char*)fx_malloc(total);
+        if(!matcher->globalbuf)
+            return FX_SET_EXN_FAST(FX_EXN_OutOfMemError);
+    }
     matcher->subbuf = bufptr;
     bufptr += subbuf_capacity;
     matcher->subsize = subsize;
@@ -305,7 +386,8 @@ static int fx_re_init_matcher(fx_re_matcher_t* matcher, const fx_str_t* input, c
 
 static void fx_re_free_matcher(fx_re_matcher_t* matcher)
 {
-    fx_free(matcher->globalbuf);
+    if(matcher->globalbuf)
+        fx_free(matcher->globalbuf);
     memset(matcher, 0, sizeof(*matcher));
 }
 
@@ -342,6 +424,66 @@ static int fx_re_count_(fx_re_ast_t *ast, int ofs)
 	}
 }
 
+// extracts the literal string that every match of the subexpression starts with;
+// 'exact' is set to true if the subexpression matches exactly this string
+static void fx_re_litprefix_(const fx_re_ast_t* ast, int ofs, char_* buf, int* len, bool* exact)
+{
+    const fx_re_astnode_t* r = ast->buf + ofs;
+    bool exact_left = false;
+    *exact = false;
+    switch(r->type) {
+    case FX_RE_LIT:
+        if(*len < FX_RE_MAXLIT) {
+            buf[(*len)++] = (char_)r->c;
+            *exact = true;
+        }
+        break;
+    case FX_RE_CAT:
+        fx_re_litprefix_(ast, r->left, buf, len, &exact_left);
+        if(exact_left)
+            fx_re_litprefix_(ast, r->right, buf, len, exact);
+        break;
+    case FX_RE_PAREN:
+        fx_re_litprefix_(ast, r->left, buf, len, exact);
+        break;
+    case FX_RE_PLUS:
+        fx_re_litprefix_(ast, r->left, buf, len, exact);
+        *exact = false;
+        break;
+    default:
+        break;
+    }
+}
+
+// finds the longest literal string that every match of the subexpression contains.
+// 'run' is the literal string that the already processed part of the
+// concatenation is guaranteed to end with
+static void fx_re_litfactor_(const fx_re_ast_t* ast, int ofs, fx_regex_t* re, char_* run, int* runlen)
+{
+    const fx_re_astnode_t* r = ast->buf + ofs;
+    if(r->type == FX_RE_CAT) {
+        fx_re_litfactor_(ast, r->left, re, run, runlen);
+        fx_re_litfactor_(ast, r->right, re, run, runlen);
+    } else {
+        bool exact = false;
+        int len = *runlen;
+        fx_re_litprefix_(ast, ofs, run, &len, &exact);
+        if(len > re->factorlen) {
+            memcpy(re->factor, run, len*sizeof(run[0]));
+            re->factorlen = len;
+        }
+        if(exact)
+            *runlen = len;
+        else {
+            *runlen = 0;
+            // the subexpression is matched at least once, so
+            // whatever it must contain, the whole regexp must contain as well
+            if(r->type == FX_RE_PAREN || r->type == FX_RE_PLUS)
+                fx_re_litfactor_(ast, r->left, re, run, runlen);
+        }
+    }
+}
+
 static int fx_re_emit_(fx_re_inst_t* prog, int len, int* pc, fx_re_ast_t *ast, int ofs)
 {
 	fx_re_inst_t *p1, *p2;
@@ -574,6 +716,403 @@ fx_re_printprog(const fx_cptr_t regex_)
     }
 }
 
+////////////////////// lazy DFA for match-only queries /////////////////////////
+
+/*
+    When the caller only needs to know whether there is a match or not
+    (a quick check before running Pike VM in fullmatch() or before extracting submatches),
+    there is no need to track submatches and thread priorities.
+    Then the list of active threads can be replaced with a DFA state,
+    i.e. the sorted set of instructions that the threads are at.
+    DFA states are constructed lazily, while the input is being scanned,
+    and the transitions on ASCII characters are cached.
+    The number of states is limited; once the limit is reached,
+    DFA gives up and the caller falls back to Pike VM.
+*/
+enum
+{
+    FX_RE_DFA_NCHARS = 128,
+    FX_RE_DFA_MAX_STATES = 1024,
+    FX_RE_DFA_INIT_STATES = 16
+};
+
+enum
+{
+    FX_RE_DFA_NOMATCH = 0,
+    FX_RE_DFA_MATCH = 1,
+    FX_RE_DFA_GIVEUP = 2
+};
+
+typedef struct fx_re_dfa_t
+{
+    const fx_re_inst_t* prog;
+    int proglen, flags;
+    int nstates, capacity;
+    int* next;          // capacity x FX_RE_DFA_NCHARS cached transitions, -1 means 'not computed yet'
+    int* setofs;        // (capacity+1) offsets of the instruction sets in 'sets'
+    unsigned* hash;     // capacity hash values of the instruction sets
+    bool* accept;       // capacity flags; true if the state includes MATCH instruction
+    int* sets;
+    int sets_capacity;
+    int* mark;          // proglen-size scratch buffers used to construct new states
+    int* stack;
+    int* newset;
+    int gen;
+    int start[4];       // cached start states for pc0=0..3, -1 means 'not computed yet'
+} fx_re_dfa_t;
+
+static void fx_re_dfa_free(fx_re_dfa_t* dfa)
+{
+    fx_free(dfa->next);
+    fx_free(dfa->setofs);
+    fx_free(dfa->hash);
+    fx_free(dfa->accept);
+    fx_free(dfa->sets);
+    fx_free(dfa->mark);
+    memset(dfa, 0, sizeof(*dfa));
+}
+
+static int fx_re_dfa_reserve_(fx_re_dfa_t* dfa, int nstates, int setsize)
+{
+    if (nstates > dfa->capacity) {
+        int new_capacity = dfa->capacity*2;
+        int *next, *setofs;
+        unsigned* hash;
+        bool* accept;
+        if (new_capacity < FX_RE_DFA_INIT_STATES)
+            new_capacity = FX_RE_DFA_INIT_STATES;
+        if (new_capacity > FX_RE_DFA_MAX_STATES)
+            return -1;
+        next = (int*)fx_realloc(dfa->next, new_capacity*FX_RE_DFA_NCHARS*sizeof(next[0]));
+        if (!next) return -1;
+        dfa->next = next;
+        memset(next + dfa->capacity*FX_RE_DFA_NCHARS, -1,
+               (new_capacity - dfa->capacity)*FX_RE_DFA_NCHARS*sizeof(next[0]));
+        setofs = (int*)fx_realloc(dfa->setofs, (new_capacity+1)*sizeof(setofs[0]));
+        if (!setofs) return -1;
+        dfa->setofs = setofs;
+        hash = (unsigned*)fx_realloc(dfa->hash, new_capacity*sizeof(hash[0]));
+        if (!hash) return -1;
+        dfa->hash = hash;
+        accept = (bool*)fx_realloc(dfa->accept, new_capacity*sizeof(accept[0]));
+        if (!accept) return -1;
+        dfa->accept = accept;
+        dfa->capacity = new_capacity;
+    }
+    if (setsize > dfa->sets_capacity) {
+        int new_capacity = dfa->sets_capacity*2;
+        int* sets;
+        if (new_capacity < setsize)
+            new_capacity = setsize + dfa->proglen*FX_RE_DFA_INIT_STATES;
+        sets = (int*)fx_realloc(dfa->sets, new_capacity*sizeof(sets[0]));
+        if (!sets) return -1;
+        dfa->sets = sets;
+        dfa->sets_capacity = new_capacity;
+    }
+    return 0;
+}
+
+// adds the instruction at 'pc0' and everything reachable from it via
+// non-consuming instructions to 'newset'; returns the updated set size
+static int fx_re_dfa_closure_(fx_re_dfa_t* dfa, int pc0, int n)
+{
+    const fx_re_inst_t* prog = dfa->prog;
+    int* mark = dfa->mark;
+    int* stack = dfa->stack;
+    int gen = dfa->gen, sp = 0;
+    stack[sp++] = pc0;
+    while (sp > 0) {
+        int pc = stack[--sp];
+        const fx_re_inst_t* r = prog + pc;
+        if (mark[pc] == gen)
+            continue;
+        mark[pc] = gen;
+        switch(r->opcode) {
+        case FX_RE_OP_JMP:
+            stack[sp++] = r->x;
+            break;
+        case FX_RE_OP_SPLIT:
+            stack[sp++] = r->y;
+            stack[sp++] = r->x;
+            break;
+        case FX_RE_OP_SAVE:
+            stack[sp++] = pc+1;
+            break;
+        default:
+            dfa->newset[n++] = pc;
+            break;
+        }
+    }
+    return n;
+}
+
+// finds the state with the instruction set stored in 'newset' or adds a new one;
+// returns the state index or -1 if the state cache is full
+static int fx_re_dfa_addstate_(fx_re_dfa_t* dfa, int n)
+{
+    const fx_re_inst_t* prog = dfa->prog;
+    int* newset = dfa->newset;
+    unsigned h = 2166136261u;
+    bool accept = false;
+    int i, j, s, nstates = dfa->nstates;
+    int* set;
+
+    // sort the set, so that equal sets have equal representation
+    for(i = 1; i < n; i++) {
+        int pc = newset[i];
+        for(j = i; j > 0 && newset[j-1] > pc; j--)
+            newset[j] = newset[j-1];
+        newset[j] = pc;
+    }
+    for(i = 0; i < n; i++) {
+        h = (h ^ (unsigned)newset[i])*16777619u;
+        accept |= prog[newset[i]].opcode == FX_RE_OP_MATCH;
+    }
+    for(s = 0; s < nstates; s++) {
+        int ofs = dfa->setofs[s];
+        if(dfa->hash[s] == h && dfa->setofs[s+1] - ofs == n &&
+           memcmp(dfa->sets + ofs, newset, n*sizeof(newset[0])) == 0)
+            return s;
+    }
+    if (fx_re_dfa_reserve_(dfa, nstates + 1, dfa->setofs[nstates] + n) < 0)
+        return -1;
+    set = dfa->sets + dfa->setofs[nstates];
+    for(i = 0; i < n; i++)
+        set[i] = newset[i];
+    dfa->setofs[nstates+1] = dfa->setofs[nstates] + n;
+    dfa->hash[nstates] = h;
+    dfa->accept[nstates] = accept;
+    dfa->nstates = nstates + 1;
+    return nstates;
+}
+
+// checks whether the instruction at 'pc' accepts character 'c';
+// returns the next instruction or -1
+static int fx_re_dfa_inst_(const fx_re_inst_t* prog, int pc, char_ c, bool ignore_case, bool multiline_mode)
+{
+    const fx_re_inst_t* r = prog + pc;
+    switch(r->opcode) {
+    case FX_RE_OP_ANY:
+        return !multiline_mode || (c != '\n' && c != '\r') ? pc+1 : -1;
+    case FX_RE_OP_CHAR:
+        return (!ignore_case ? c == r->c : (c == r->x || c == r->y)) ? pc+1 : -1;
+    case FX_RE_OP_RANGE:
+        {
+        char_ c0 = c, c1 = c;
+        int k, n = r->n;
+        if(ignore_case) {
+            c0 = fx_tolower(c);
+            c1 = fx_toupper(c);
+        }
+        for(k = 0; k < n; k++) {
+            const fx_re_inst_t* rk = prog + pc + 1 + k;
+            if(rk->opcode == FX_RE_OP_CHAR) {
+                if(c0 == rk->c || c1 == rk->c) break;
+            } else if(rk->opcode == FX_RE_OP_RANGE) {
+                if((rk->x <= c0 && c0 <= rk->y) ||
+                   (rk->x <= c1 && c1 <= rk->y)) break;
+            } else if(rk->opcode == FX_RE_OP_CLASS_ALPHA) {
+                if(fx_isalpha(c)) break;
+            } else if(rk->opcode == FX_RE_OP_CLASS_IDENT) {
+                if(fx_isalnum(c) || c == '_') break;
+            } else if(rk->opcode == FX_RE_OP_CLASS_DIGIT) {
+                if(fx_isdigit(c)) break;
+            } else if(rk->opcode == FX_RE_OP_CLASS_SPACE) {
+                if(fx_isspace(c)) break;
+            } else if(rk->opcode == FX_RE_OP_CLASS_NON_SPACE) {
+                if(!fx_isspace(c)) break;
+            }
+        }
+        return ((r->c != 0) ^ (k < n)) ? pc + 1 + n : -1;
+        }
+    case FX_RE_OP_CLASS_ALPHA:
+        return fx_isalpha(c) ? pc+1 : -1;
+    case FX_RE_OP_CLASS_IDENT:
+        return fx_isalnum(c) || c == '_' ? pc+1 : -1;
+    case FX_RE_OP_CLASS_DIGIT:
+        return fx_isdigit(c) ? pc+1 : -1;
+    case FX_RE_OP_CLASS_SPACE:
+        return fx_isspace(c) && (!multiline_mode || (c != '\n' && c != '\r')) ? pc+1 : -1;
+    case FX_RE_OP_CLASS_NON_SPACE:
+        return fx_isspace(c) && (!multiline_mode || (c != '\n' && c != '\r')) ? -1 : pc+1;
+    default:
+        return -1;
+    }
+}
+
+static int fx_re_dfa_init(fx_re_dfa_t* dfa, const fx_regex_t* regex, int flags)
+{
+    int proglen = regex->len;
+    memset(dfa, 0, sizeof(*dfa));
+    dfa->prog = regex->prog;
+    dfa->proglen = proglen;
+    dfa->flags = flags & (FX_RE_IGNORECASE | FX_RE_MULTILINE);
+    dfa->mark = (int*)fx_malloc(proglen*3*sizeof(dfa->mark[0]));
+    if(!dfa->mark)
+        return FX_SET_EXN_FAST(FX_EXN_OutOfMemError);
+    memset(dfa->mark, 0, proglen*sizeof(dfa->mark[0]));
+    dfa->stack = dfa->mark + proglen;
+    dfa->newset = dfa->stack + proglen;
+    if(fx_re_dfa_reserve_(dfa, 1, 0) < 0) {
+        fx_re_dfa_free(dfa);
+        return FX_SET_EXN_FAST(FX_EXN_OutOfMemError);
+    }
+    // state 0 is the dead state, i.e. the empty set of instructions
+    dfa->setofs[0] = 0;
+    fx_re_dfa_addstate_(dfa, 0);
+    for(int i = 0; i < 4; i++)
+        dfa->start[i] = -1;
+    return FX_OK;
+}
+
+static int fx_re_dfa_start_(fx_re_dfa_t* dfa, int pc0)
+{
+    int s = dfa->start[pc0];
+    if(s < 0) {
+        dfa->gen++;
+        s = dfa->start[pc0] = fx_re_dfa_addstate_(dfa, fx_re_dfa_closure_(dfa, pc0, 0));
+    }
+    return s;
+}
+
+static int fx_re_dfa_step_(fx_re_dfa_t* dfa, int s, char_ c)
+{
+    bool ignore_case = (dfa->flags & FX_RE_IGNORECASE) != 0;
+    bool multiline_mode = (dfa->flags & FX_RE_MULTILINE) != 0;
+    int i, n = 0, s1, ofs = dfa->setofs[s], nthreads = dfa->setofs[s+1] - ofs;
+    dfa->gen++;
+    for(i = 0; i < nthreads; i++) {
+        int pc = fx_re_dfa_inst_(dfa->prog, dfa->sets[ofs + i], c, ignore_case, multiline_mode);
+        if(pc >= 0)
+            n = fx_re_dfa_closure_(dfa, pc, n);
+    }
+    s1 = fx_re_dfa_addstate_(dfa, n);
+    if(s1 >= 0 && c < FX_RE_DFA_NCHARS)
+        dfa->next[s*FX_RE_DFA_NCHARS + c] = s1;
+    return s1;
+}
+
+// Runs DFA on input[start:], starting from the instruction 'pc0'.
+// If 'fullmatch' is true, the whole string must be matched,
+// otherwise it's enough to reach MATCH at any position.
+static int fx_re_dfa_run_(fx_re_dfa_t* dfa, const fx_str_t* input, int_ start, int pc0, bool fullmatch)
+{
+    const char_* str = input->data;
+    int_ j, len = input->length;
+    const int* next;
+    int s = fx_re_dfa_start_(dfa, pc0);
+    if(s < 0)
+        return FX_RE_DFA_GIVEUP;
+    for(j = start; j < len; j++) {
+        char_ c = str[j];
+        int s1;
+        if(!fullmatch && dfa->accept[s])
+            return FX_RE_DFA_MATCH;
+        next = dfa->next;
+        s1 = c < FX_RE_DFA_NCHARS ? next[s*FX_RE_DFA_NCHARS + c] : -1;
+        if(s1 < 0) {
+            s1 = fx_re_dfa_step_(dfa, s, c);
+            if(s1 < 0)
+                return FX_RE_DFA_GIVEUP;
+        }
+        s = s1;
+        if(s == 0)
+            return FX_RE_DFA_NOMATCH;
+    }
+    return dfa->accept[s] ? FX_RE_DFA_MATCH : FX_RE_DFA_NOMATCH;
+}
+
+// Checks whether there is a match at all (or a full match if 'fullmatch' is true).
+// Returns FX_RE_DFA_MATCH, FX_RE_DFA_NOMATCH or FX_RE_DFA_GIVEUP
+// (in the latter case the regexp must be processed by Pike VM)
+static int fx_re_dfa_test_(const fx_regex_t* regex, const fx_str_t* input, int flags, bool fullmatch)
+{
+    fx_re_scratch_t* scratch = &fx_re_scratch_;
+    fx_re_dfa_t* dfa = 0;
+    int i, status;
+    // see fx_re_pikevm_ about the '.*?' prefix skipped in the match mode
+    int pc0 = fullmatch || (flags & FX_RE_MODE_MASK_) == FX_RE_MATCH_MODE_ ? 3 : 0;
+    if(!regex->use_dfa)
+        return FX_RE_DFA_GIVEUP;
+    flags &= FX_RE_IGNORECASE | FX_RE_MULTILINE;
+    // reuse the DFA, constructed by the previous calls, if any
+    for(i = 0; i < FX_RE_SCRATCH_NDFA; i++) {
+        if(scratch->dfa[i] && scratch->dfa_id[i] == regex->id && scratch->dfa_flags[i] == flags) {
+            dfa = scratch->dfa[i];
+            break;
+        }
+    }
+    if(!dfa) {
+        i = scratch->dfa_victim;
+        scratch->dfa_victim = (i + 1) % FX_RE_SCRATCH_NDFA;
+        dfa = scratch->dfa[i];
+        if(dfa)
+            fx_re_dfa_free(dfa);
+        else {
+            dfa = (fx_re_dfa_t*)fx_malloc(sizeof(*dfa));
+            if(!dfa)
+                return FX_RE_DFA_GIVEUP;
+            scratch->dfa[i] = dfa;
+        }
+        scratch->dfa_id[i] = 0;
+        status = fx_re_dfa_init(dfa, regex, flags);
+        if(status < 0)
+            return FX_RE_DFA_GIVEUP;
+        scratch->dfa_id[i] = regex->id;
+        scratch->dfa_flags[i] = flags;
+    }
+    // prevent overflow of the generation counter (it's incremented
+    // only when a new transition is computed, so it's very unlikely)
+    if(dfa->gen > INT_MAX/2) {
+        memset(dfa->mark, 0, dfa->proglen*sizeof(dfa->mark[0]));
+        dfa->gen = 0;
+    }
+    status = fx_re_dfa_run_(dfa, input, 0, pc0, fullmatch);
+    if(status == FX_RE_DFA_GIVEUP) {
+        // the state cache is full; start from scratch next time
+        fx_re_dfa_free(dfa);
+        scratch->dfa_id[i] = 0;
+    }
+    return status;
+}
+
+////////////////////// literal search /////////////////////////
+
+// finds the first occurrence of the literal string 'lit' in str[start:]
+static int_ fx_re_findlit_(const char_* str, int_ len, int_ start, const char_* lit, int litlen)
+{
+    char_ c0 = lit[0];
+    int_ j, last = len - litlen;
+    for(j = start; j <= last; j++) {
+        // scan for the first character, 4 characters per iteration
+        for(; j + 3 <= last; j += 4) {
+            if((str[j] == c0) | (str[j+1] == c0) | (str[j+2] == c0) | (str[j+3] == c0))
+                break;
+        }
+        // the unrolled loop may step right past the last position
+        if(j > last)
+            break;
+        if(str[j] == c0 && memcmp(str + j + 1, lit + 1, (litlen - 1)*sizeof(lit[0])) == 0)
+            return j;
+    }
+    return -1;
+}
+
+// checks whether the string may contain a match at all;
+// in the match mode it also checks that the string starts with the literal prefix
+static bool fx_re_checklit_(const fx_regex_t* regex, const fx_str_t* input, int flags)
+{
+    int_ len = input->length;
+    if((flags & FX_RE_IGNORECASE) != 0)
+        return true;
+    if((flags & FX_RE_MODE_MASK_) == FX_RE_MATCH_MODE_ && regex->prefixlen > 0 &&
+       (len < regex->prefixlen ||
+        memcmp(input->data, regex->prefix, regex->prefixlen*sizeof(regex->prefix[0])) != 0))
+        return false;
+    return regex->factorlen == 0 ||
+        fx_re_findlit_(input->data, len, 0, regex->factor, regex->factorlen) >= 0;
+}
+
 static int
 fx_re_pikevm_(const fx_cptr_t regex_, const fx_str_t* input, int flags,
               int_** outsub_, int outsub_capacity0, int* outnsub)
@@ -592,8 +1131,21 @@ fx_re_pikevm_(const fx_cptr_t regex_, const fx_str_t* input, int flags,
     int outsub_capacity = outsub_capacity0;
     int nmatches = 0, pc0 = 0;
     int mode = flags & FX_RE_MODE_MASK_;
+    int status;
+    const fx_regex_t* regex = regex_ ? (const fx_regex_t*)regex_->ptr : 0;
+    // in the find mode we can jump right to the next occurrence of the literal prefix.
+    // In the multiline mode '.*?' does not cross line boundaries, so we do not skip anything
+    bool skip_to_prefix = regex && mode != FX_RE_MATCH_MODE_ &&
+        regex->prefixlen > 0 && !ignore_case && !multiline_mode;
+
+    // quickly reject the inputs that do not contain any match, unless the caller has done it already
+    if(regex && (flags & FX_RE_PREFILTERED_) == 0 && (!fx_re_checklit_(regex, input, flags) ||
+        fx_re_dfa_test_(regex, input, flags, false) == FX_RE_DFA_NOMATCH)) {
+        *outnsub = regex->nsub;
+        return 0;
+    }
 
-    int status = fx_re_init_matcher(&matcher, input, regex_);
+    status = fx_re_init_matcher(&matcher, input, regex_);
     if(status < 0) return status;
 
     nsub = matcher.nsub;
@@ -613,6 +1165,11 @@ fx_re_pikevm_(const fx_cptr_t regex_, const fx_str_t* input, int flags,
     *outnsub = nsub;
 
     while(j < strlen) {
+        if(skip_to_prefix) {
+            j = fx_re_findlit_(str, strlen, j, regex->prefix, regex->prefixlen);
+            if(j < 0)
+                break;
+        }
         //printf("start/resume from j=%d\n", (int)j);
         if(j > 0) {
             fx_re_reset_matcher(&matcher);
@@ -1083,7 +1640,21 @@ int fx_re_fullmatch(const fx_cptr_t regex, const fx_str_t* str, int flags)
 {
     int_ subbuf[FX_RE_SUB_BUFSIZE], *sub = subbuf;
     int nsub = 0, status;
-    status = fx_re_pikevm_(regex, str, flags | FX_RE_MATCH_MODE_, &sub, FX_RE_SUB_BUFSIZE, &nsub);
+    if (!regex || !regex->ptr)
+        return FX_SET_EXN_FAST(FX_EXN_NullPtrError);
+    if(!fx_re_checklit_((fx_regex_t*)regex->ptr, str, flags | FX_RE_MATCH_MODE_))
+        return 0;
+    /* DFA checks whether any match spans the whole string, whereas fullmatch()
+       checks that the preferred (leftmost-first) match does, e.g. r"a|ab" matches
+       just "a" in "ab". So the positive answers of DFA are only final when the regexp
+       has a single way to match a string; otherwise they are confirmed using Pike VM */
+    status = fx_re_dfa_test_((fx_regex_t*)regex->ptr, str, flags, true);
+    if(status == FX_RE_DFA_NOMATCH)
+        return 0;
+    if(status == FX_RE_DFA_MATCH && ((fx_regex_t*)regex->ptr)->single_path)
+        return 1;
+    status = fx_re_pikevm_(regex, str, flags | FX_RE_MATCH_MODE_ | FX_RE_PREFILTERED_,
+                           &sub, FX_RE_SUB_BUFSIZE, &nsub);
     if(status > 0) {
         status = sub[1] == str->length;
     }
@@ -265,19 +265,31 @@ static int _fx_char_category(char_ ch)
     return _fx_uni_getdata(ch) & FX_UNICODE_CAT_Mask;
 }
 
+// ASCII characters are the most common ones, so they are classified without table lookups
+#define FX_ASCII_ISUPPER(ch) ((unsigned)((ch) - 'A') < 26u)
+#define FX_ASCII_ISLOWER(ch) ((unsigned)((ch) - 'a') < 26u)
+#define FX_ASCII_ISDIGIT(ch) ((unsigned)((ch) - '0') < 10u)
+#define FX_ASCII_ISSPACE(ch) ((ch) == ' ' || (unsigned)((ch) - '\t') < 5u)
+
 bool fx_isalpha(char_ ch)
 {
+    if (ch < 128)
+        return FX_ASCII_ISUPPER(ch) | FX_ASCII_ISLOWER(ch);
     return _fx_char_category(ch) <= FX_UNICODE_CAT_Lo;
 }
 
 bool fx_isdigit(char_ ch)
 {
+    if (ch < 128)
+        return FX_ASCII_ISDIGIT(ch);
     return (((1 << FX_UNICODE_CAT_Nd) |
             (1 << FX_UNICODE_CAT_No)) & (1 << _fx_char_category(ch))) != 0;
 }
 
 bool fx_isalnum(char_ ch)
 {
+    if (ch < 128)
+        return FX_ASCII_ISUPPER(ch) | FX_ASCII_ISLOWER(ch) | FX_ASCII_ISDIGIT(ch);
     return (((1 << FX_UNICODE_CAT_Lu) |
             (1 << FX_UNICODE_CAT_Ll) |
             (1 << FX_UNICODE_CAT_Lt) |
@@ -306,6 +318,8 @@ bool fx_isdecimal(char_ ch)
 
 bool fx_isspace(char_ ch)
 {
+    if (ch < 128)
+        return FX_ASCII_ISSPACE(ch);
     return (((1 << FX_UNICODE_CAT_Zs) |
             (1 << FX_UNICODE_CAT_Zl) |
             (1 << FX_UNICODE_CAT_Zp) |
@@ -314,6 +328,8 @@ bool fx_isspace(char_ ch)
 
 char_ fx_tolower(char_ ch)
 {
+    if (ch < 128)
+        return ch + (FX_ASCII_ISUPPER(ch) << 5);
     int cdata = _fx_uni_getdata(ch);
     int cat = cdata & FX_UNICODE_CAT_Mask;
     int ofs = cat == FX_UNICODE_CAT_Lu ? (cdata >> (FX_UNICODE_CAT_Shift + FX_UNICODE_BIDIR_Shift)) : 0;
@@ -322,12 +338,193 @@ char_ fx_tolower(char_ ch)
 
 char_ fx_toupper(char_ ch)
 {
+    if (ch < 128)
+        return ch - (FX_ASCII_ISLOWER(ch) << 5);
     int cdata = _fx_uni_getdata(ch);
     int cat = cdata & FX_UNICODE_CAT_Mask;
     int ofs = cat == FX_UNICODE_CAT_Ll ? (cdata >> (FX_UNICODE_CAT_Shift + FX_UNICODE_BIDIR_Shift)) : 0;
     return (char_)(ch + ofs);
 }
 
+/*
+    Whole-string operations.
+    The strings are processed in blocks of FX_STR_BLOCK characters.
+    If all the characters in a block are ASCII, which is checked with a single
+    comparison, the block is processed by a simple branch-free loop that
+    the C compiler can vectorize; otherwise each character of the block
+    is processed using the unicode tables.
+*/
+enum { FX_STR_BLOCK = 16 };
+
+static bool _fx_isascii_block(const char_* ptr)
+{
+    char_ m = 0;
+    for (int k = 0; k < FX_STR_BLOCK; k++)
+        m |= ptr[k];
+    return m < 128;
+}
+
+static int _fx_str_changecase(const fx_str_t* src, bool upper, fx_str_t* dst)
+{
+    const char_* ptr = src->data;
+    char_ c0 = upper ? 'a' : 'A';
+    int_ i = 0, len = src->length;
+    // find the first character to change; if there is no such, return the original string
+    for (; i < len; ) {
+        int_ iend = i + FX_STR_BLOCK;
+        if (iend <= len && _fx_isascii_block(ptr + i)) {
+            bool changed = false;
+            for (int k = 0; k < FX_STR_BLOCK; k++)
+                changed |= (unsigned)(ptr[i + k] - c0) < 26u;
+            if (!changed) {
+                i = iend;
+                continue;
+            }
+        }
+        if (iend > len) iend = len;
+        for (; i < iend; i++) {
+            char_ c = ptr[i];
+            if ((upper ? fx_toupper(c) : fx_tolower(c)) != c)
+                break;
+        }
+        if (i < iend)
+            break;
+    }
+    if (i == len) {
+        fx_copy_str(src, dst);
+        return FX_OK;
+    }
+    int fx_status = fx_make_str(0, len, dst);
+    if (fx_status >= 0) {
+        char_* dstptr = dst->data;
+        int_ j = 0;
+        memcpy(dstptr, ptr, i*sizeof(ptr[0]));
+        for (j = i; j < len; ) {
+            int_ jend = j + FX_STR_BLOCK;
+            if (jend <= len && _fx_isascii_block(ptr + j)) {
+                if (upper) {
+                    for (; j < jend; j++)
+                        dstptr[j] = ptr[j] - (FX_ASCII_ISLOWER(ptr[j]) << 5);
+                } else {
+                    for (; j < jend; j++)
+                        dstptr[j] = ptr[j] + (FX_ASCII_ISUPPER(ptr[j]) << 5);
+                }
+            } else {
+                if (jend > len) jend = len;
+                for (; j < jend; j++)
+                    dstptr[j] = upper ? fx_toupper(ptr[j]) : fx_tolower(ptr[j]);
+            }
+        }
+    }
+    return fx_status;
+}
+
+int fx_str_tolower(const fx_str_t* src, fx_str_t* dst)
+{
+    return _fx_str_changecase(src, false, dst);
+}
+
+int fx_str_toupper(const fx_str_t* src, fx_str_t* dst)
+{
+    return _fx_str_changecase(src, true, dst);
+}
+
+// finds the first character in ptr[start:len] that is (if 'space' is true) or
+// is not (if 'space' is false) a whitespace character; returns 'len' if there is no such
+int_ fx_str_skipspace(const char_* ptr, int_ start, int_ len, bool space)
+{
+    int_ i = start;
+    for (; i < len; ) {
+        int_ iend = i + FX_STR_BLOCK;
+        if (iend <= len && _fx_isascii_block(ptr + i)) {
+            bool found = false;
+            for (int k = 0; k < FX_STR_BLOCK; k++)
+                found |= FX_ASCII_ISSPACE(ptr[i + k]) == space;
+            if (!found) {
+                i = iend;
+                continue;
+            }
+        }
+        if (iend > len) iend = len;
+        for (; i < iend; i++) {
+            if (fx_isspace(ptr[i]) == space)
+                return i;
+        }
+    }
+    return len;
+}
+
+// splits the string into the whitespace-separated tokens;
+// returns the array of (start, end) pairs
+int fx_str_tokens_space(const fx_str_t* str, fx_arr_t* result)
+{
+    const char_* ptr = str->data;
+    int_ i = 0, len = str->length, ntokens = 0;
+    int_ buf[256], bufsz = 256;
+    int_ *pos = buf;
+    for (;;) {
+        i = fx_str_skipspace(ptr, i, len, false);
+        if (i >= len)
+            break;
+        if (ntokens*2 >= bufsz) {
+            int_* newpos = (int_*)fx_malloc(bufsz*2*sizeof(pos[0]));
+            if (!newpos) {
+                if (pos != buf) fx_free(pos);
+                FX_FAST_THROW_RET(FX_EXN_OutOfMemError);
+            }
+            memcpy(newpos, pos, bufsz*sizeof(pos[0]));
+            if (pos != buf) fx_free(pos);
+            pos = newpos;
+            bufsz *= 2;
+        }
+        pos[ntokens*2] = i;
+        i = fx_str_skipspace(ptr, i, len, true);
+        pos[ntokens*2+1] = i;
+        ntokens++;
+    }
+    int fx_status = fx_make_arr(1, &ntokens, sizeof(int_)*2, 0, 0, pos, result);
+    if (pos != buf) fx_free(pos);
+    return fx_status;
+}
+
+// splits the string into the fields separated by 'c'.
+// The fields are counted first, so that the array is allocated just once,
+// and each field shares the buffer with the original string
+int fx_str_split(const fx_str_t* str, char_ c, bool allow_empty, fx_arr_t* result)
+{
+    const char_* ptr = str->data;
+    int_ i, len = str->length, start = 0, n = 0, k = 0;
+    bool sep = true;
+    for (i = 0; i < len; i++) {
+        bool sepi = ptr[i] == c;
+        n += sepi & (!sep | allow_empty);
+        sep = sepi;
+    }
+    n += !sep;
+    int fx_status = fx_make_arr(1, &n, sizeof(fx_str_t), (fx_free_t)fx_free_str,
+                                (fx_copy_t)fx_copy_str, 0, result);
+    if (fx_status < 0)
+        return fx_status;
+    fx_str_t* fields = (fx_str_t*)result->data;
+    sep = true;
+    for (i = 0; i < len && fx_status >= 0; i++) {
+        if (ptr[i] == c) {
+            if (!sep || allow_empty)
+                fx_status = fx_substr(str, start, i, 1, 0, fields + k++);
+            start = i + 1;
+            sep = true;
+        } else if (sep) {
+            start = i;
+            sep = false;
+        }
+    }
+    if (fx_status >= 0 && !sep)
+        fx_status = fx_substr(str, start, len, 1, 0, fields + k++);
+    if (fx_status < 0)
+        fx_free_arr(result);
+    return fx_status;
+}
+
 int fx_todigit(char_ ch)
 {
     int cdata = _fx_uni_getdata(ch);
@@ -379,7 +576,22 @@ bool fx_atoi(const fx_str_t* str, int_* result, int base)
         return false;
 
     if( base == 10 ) {
-        for( i = 0; i < len; i++ ) {
+        // the long runs of ASCII digits are processed in blocks of 8 digits.
+        // The digits of each block are combined independently of 'r',
+        // so there is no long dependency chain
+        for( i = 0; i + 8 <= len; i += 8 ) {
+            unsigned bad = 0;
+            int_ v = 0;
+            for( int k = 0; k < 8; k++ ) {
+                unsigned digit = (unsigned)(ptr[i+k] - '0');
+                bad |= digit >= 10u;
+                v = v*10 + digit;
+            }
+            if(bad)
+                break;
+            r = r*100000000 + v;
+        }
+        for( ; i < len; i++ ) {
             int digit = fx_todigit(ptr[i]);
             if(digit < 0)
                 break;
@@ -433,6 +645,55 @@ bool fx_atof(const fx_str_t* str, double* result)
     return ok;
 }
 
+// parses the numbers, separated by 'sep' and/or whitespace characters, into 1D array.
+// The numbers are counted first, so that the array is allocated just once
+static int _fx_str_parse_nums(const fx_str_t* str, char_ sep, bool ints, fx_arr_t* result)
+{
+    const char_* ptr = str->data;
+    int_ i = 0, len = str->length, n = 0, k = 0;
+    for(;;) {
+        for(; i < len && (ptr[i] == sep || fx_isspace(ptr[i])); i++)
+            ;
+        if(i >= len)
+            break;
+        for(; i < len && ptr[i] != sep && !fx_isspace(ptr[i]); i++)
+            ;
+        n++;
+    }
+    int fx_status = fx_make_arr(1, &n, ints ? sizeof(int_) : sizeof(double), 0, 0, 0, result);
+    if(fx_status < 0)
+        return fx_status;
+    for(i = 0; k < n; k++) {
+        fx_str_t token = {0, 0, 0};
+        bool ok;
+        int_ start;
+        for(; ptr[i] == sep || fx_isspace(ptr[i]); i++)
+            ;
+        start = i;
+        for(; i < len && ptr[i] != sep && !fx_isspace(ptr[i]); i++)
+            ;
+        token.data = (char_*)ptr + start;
+        token.length = i - start;
+        ok = ints ? fx_atoi(&token, (int_*)result->data + k, 10) :
+                    fx_atof(&token, (double*)result->data + k);
+        if(!ok) {
+            fx_free_arr(result);
+            FX_FAST_THROW_RET(FX_EXN_BadArgError);
+        }
+    }
+    return FX_OK;
+}
+
+int fx_str_parse_ints(const fx_str_t* str, char_ sep, fx_arr_t* result)
+{
+    return _fx_str_parse_nums(str, sep, true, result);
+}
+
+int fx_str_parse_doubles(const fx_str_t* str, char_ sep, fx_arr_t* result)
+{
+    return _fx_str_parse_nums(str, sep, false, result);
+}
+
 int fx_itoa(int64_t n, bool nosign, fx_str_t* str)
 {
     static const char* tab =
@@ -51,6 +51,122 @@ double fx_tick_frequency(void)
 #endif
 }
 
+/* a simple lock for the short critical sections in the code that is not a part of
+   @parallel for loop (where @sync can be used), e.g. in the functions
+   that may be called from several threads. The lock is a zero-initialized int_ variable */
+void fx_spin_lock(int_* lock)
+{
+    for (int iter = 0;; iter++) {
+#ifdef _MSC_VER
+    #if defined _M_X64 || defined _M_ARM64
+        if (_InterlockedCompareExchange64((__int64 volatile*)lock, 1, 0) == 0)
+    #else
+        if (_InterlockedCompareExchange((long volatile*)lock, 1, 0) == 0)
+    #endif
+            break;
+#else
+        if (__sync_bool_compare_and_swap(lock, 0, 1))
+            break;
+#endif
+        if (iter >= 100) {
+        #if defined _WIN32 || defined WINCE
+            SwitchToThread();
+        #else
+            sched_yield();
+        #endif
+            iter = 0;
+        }
+    }
+}
+
+void fx_spin_unlock(int_* lock)
+{
+#ifdef _MSC_VER
+    #if defined _M_X64 || defined _M_ARM64
+    _InterlockedExchange64((__int64 volatile*)lock, 0);
+    #else
+    _InterlockedExchange((long volatile*)lock, 0);
+    #endif
+#else
+    __sync_lock_release(lock);
+#endif
+}
+
+/* a readers-writer variant of the spin lock. The lock is a zero-initialized int_ variable
+   that contains the number of readers; the highest bit is set by the writer.
+   The new readers wait until the writer is done, and the writer waits
+   until the current readers leave */
+#define FX_SPIN_WRITER_ ((int_)1 << (sizeof(int_)*8 - 2))
+
+static int fx_spin_cas_(int_* lock, int_ prev, int_ val)
+{
+#ifdef _MSC_VER
+    #if defined _M_X64 || defined _M_ARM64
+    return _InterlockedCompareExchange64((__int64 volatile*)lock, val, prev) == prev;
+    #else
+    return _InterlockedCompareExchange((long volatile*)lock, val, prev) == prev;
+    #endif
+#else
+    return __sync_bool_compare_and_swap(lock, prev, val);
+#endif
+}
+
+static void fx_spin_pause_(int* iter)
+{
+    if (++*iter >= 100) {
+    #if defined _WIN32 || defined WINCE
+        SwitchToThread();
+    #else
+        sched_yield();
+    #endif
+        *iter = 0;
+    }
+}
+
+void fx_spin_lock_shared(int_* lock)
+{
+    for (int iter = 0;; fx_spin_pause_(&iter)) {
+        int_ val = *(volatile int_*)lock;
+        if ((val & FX_SPIN_WRITER_) == 0 && fx_spin_cas_(lock, val, val + 1))
+            break;
+    }
+}
+
+void fx_spin_unlock_shared(int_* lock)
+{
+    FX_XADD(lock, -1);
+}
+
+void fx_spin_lock_exclusive(int_* lock)
+{
+    int iter = 0;
+    for (;; fx_spin_pause_(&iter)) {
+        int_ val = *(volatile int_*)lock;
+        if ((val & FX_SPIN_WRITER_) == 0 && fx_spin_cas_(lock, val, val | FX_SPIN_WRITER_))
+            break;
+    }
+    while (*(volatile int_*)lock != FX_SPIN_WRITER_)
+        fx_spin_pause_(&iter);
+}
+
+void fx_spin_unlock_exclusive(int_* lock)
+{
+    FX_XADD(lock, -FX_SPIN_WRITER_);
+}
+
+/* appends the function call counters, collected by the instrumented application
+   (see -pgo-gen option of ficus compiler), to the profile. Each line is '<function key> <count>';
+   the counters from different runs are summed up when the profile is loaded */
+void fx_prof_dump(const char* filename, int n, const char** keys, const uint64_t* counts)
+{
+    FILE* f = fopen(filename, "at");
+    if (!f)
+        return;
+    for (int i = 0; i < n; i++)
+        fprintf(f, "%s %llu\n", keys[i], (unsigned long long)counts[i]);
+    fclose(f);
+}
+
 #ifdef __cplusplus
 }
 #endif
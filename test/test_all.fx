@@ -25,6 +25,10 @@ import test_filename
 import test_oop
 import test_parallel
 import test_vec
+import test_bytes
+import test_rope
+import test_multimatch
+import test_incremental
 
 fun print_hdr()
 {
@@ -729,6 +729,35 @@ TEST("basic.string", fun()
     val str = "This is a sentence made of words separated by spaces."
     EXPECT_EQ(`str.tokens(fun (c) {c == ' '})`,
         ["This", "is", "a", "sentence", "made", "of", "words", "separated", "by", "spaces."])
+    EXPECT_EQ(`(" \t" + str + "\r\n  ").tokens()`, str.tokens(fun (c) {c == ' '}))
+    EXPECT_EQ(`" \n ".tokens()`, [])
+    EXPECT_EQ(`str.tokens_array(fun (c) {c == ' ' || c == '.'})`,
+        [| "This", "is", "a", "sentence", "made", "of", "words", "separated", "by", "spaces" |])
+    EXPECT_EQ(`size("  ".tokens_array(fun (c) {c == ' '}))`, 0)
+
+    val csv = ",a,,bc,d,"
+    EXPECT_EQ(`csv.split(',', allow_empty=true)`, ["", "a", "", "bc", "d"])
+    EXPECT_EQ(`csv.split(',', allow_empty=false)`, ["a", "bc", "d"])
+    EXPECT_EQ(`csv.split_array(',', allow_empty=true)`, [| "", "a", "", "bc", "d" |])
+    EXPECT_EQ(`size("".split_array(',', allow_empty=true))`, 0)
+    var fields: string list = []
+    csv.split_iter(',', fun (field) {fields = field :: fields}, allow_empty=false)
+    EXPECT_EQ(`fields.rev()`, ["a", "bc", "d"])
+    var ntokens = 0
+    str.tokens_iter(fun (c) {c == ' '}, fun (_) {ntokens += 1})
+    EXPECT_EQ(`ntokens`, 10)
+
+    EXPECT_EQ(`"1234567890123456".to_int()`, Some(1234567890123456))
+    EXPECT_EQ(`"-12345678x".to_int()`, None)
+    EXPECT_EQ(`"1, -2,3\n 123456789012,\n".parse_ints(',')`, [| 1, -2, 3, 123456789012 |])
+    EXPECT_EQ(`"0.5;1e3;-2".parse_doubles(';')`, [| 0.5, 1000., -2. |])
+    EXPECT_THROWS(`fun () {ignore("1,x,3".parse_ints(','))}`, BadArgError)
+
+    val mixed = "Hello, Мир! " * 3 + "ASCII-only text that is long enough to fill several blocks"
+    EXPECT_EQ(`mixed.toupper()`, "HELLO, МИР! " * 3 + "ASCII-ONLY TEXT THAT IS LONG ENOUGH TO FILL SEVERAL BLOCKS")
+    EXPECT_EQ(`mixed.tolower()`, "hello, мир! " * 3 + "ascii-only text that is long enough to fill several blocks")
+    EXPECT_EQ(`"  \t\u3000 a b \n ".strip()`, "a b")
+    EXPECT_EQ(`(" " * 40 + "x").lstrip()`, "x")
 
     EXPECT_EQ(`"Привет! 你好吗?".length()`, 12)
     println("NOTE: If you get a test failure here on Windows, set Windows locale to UTF-8, as described here:\n\
@@ -801,3 +830,27 @@ TEST("basic.finally", fun()
     EXPECT_EQ(`res1`, 1)
     EXPECT_EQ(`finalized1`, "ok1")
 })
+
+fun apply_twice_(f: int->int, x: int) = f(f(x))
+
+TEST("basic.higher_order_calls", fun()
+{
+    // the calls with known functional arguments are specialized by the compiler
+    val keys = [| 5, 3, 9, 1, 7 |]
+    val idx = [| 0, 1, 2, 3, 4 |]
+    sort(idx, fun (i, j) {keys[i] < keys[j]})
+    EXPECT_EQ(`idx`, [| 3, 1, 0, 4, 2 |])
+
+    var total = 0
+    val r = [1, 2, 3].map(fun (x) {total += x; x*10})
+    EXPECT_EQ(`r`, [10, 20, 30])
+    EXPECT_EQ(`total`, 6)
+
+    val a = 100
+    fun h(x: int) = x + a
+    val fold s = 0 for i <- 0:3 {
+        fun h2(x: int) = x*i + a
+        s + apply_twice_(h2, i) + apply_twice_(h, i)
+    }
+    EXPECT_EQ(`s`, 1212)
+})
@@ -0,0 +1,50 @@
+/*
+    This file is a part of ficus language project.
+    See ficus/LICENSE for the licensing terms
+*/
+
+// tests for the byte strings
+from UTest import *
+import Bytes, File, Sys
+
+TEST("bytes.basic", fun() {
+    val b = Bytes.from_string("GET /index.html HTTP/1.1")
+    EXPECT_EQ(`b.length()`, 24)
+    EXPECT_EQ(`b.at(0)`, 71u8)
+    EXPECT_EQ(`b.slice(4, 15).to_string()`, "/index.html")
+    EXPECT_EQ(`b.slice(20, 100).to_string()`, "/1.1")
+    EXPECT_EQ(`b.find(Bytes.from_string("HTTP"))`, 16)
+    EXPECT_EQ(`b.find(Bytes.from_string("HTTPS"))`, -1)
+    EXPECT_EQ(`b.find(47u8, start=5)`, 20)
+    EXPECT_EQ(`b.slice(4, 15).find(47u8, start=-1)`, 0)
+    EXPECT_EQ(`b.slice(4, 15).find(47u8, start=1)`, -1)
+    EXPECT_EQ(`b.find(49u8, start=24)`, -1)
+    EXPECT_EQ(`b.startswith(Bytes.from_string("GET "))`, true)
+    EXPECT_EQ(`b.endswith(Bytes.from_string("1.0"))`, false)
+    EXPECT_EQ(`b.slice(0, 3) == Bytes.from_string("GET")`, true)
+    EXPECT_EQ(`b.slice(0, 3) <=> Bytes.from_string("GETX")`, -1)
+    EXPECT_EQ(`b.slice(0, 3).hash()`, Bytes.from_string("GET").hash())
+    EXPECT_EQ(`(b.slice(0, 4) + b.slice(16, 24)).to_string()`, "GET HTTP/1.1")
+    EXPECT_EQ(`Bytes.from_string("Привет").length()`, 12)
+    EXPECT_EQ(`Bytes.from_string("Привет").to_string()`, "Привет")
+    EXPECT_THROWS(`fun () {ignore(b.at(24))}`, OutOfRangeError)
+})
+
+TEST("bytes.split", fun() {
+    val b = Bytes.from_string(",a,,bc,d,")
+    val fields = b.split(44u8, allow_empty=true)
+    EXPECT_EQ(`[| for f <- fields {f.to_string()} |]`, [| "", "a", "", "bc", "d" |])
+    val fields = b.split(44u8, allow_empty=false)
+    EXPECT_EQ(`[| for f <- fields {f.to_string()} |]`, [| "a", "bc", "d" |])
+})
+
+TEST("bytes.array_and_file", fun() {
+    val a = [| for i <- 0:256 {uint8(i)} |]
+    val b = Bytes.from_array(a)
+    EXPECT_EQ(`b.array()`, a)
+    EXPECT_EQ(`b.slice(250, 256).array()`, [| 250u8, 251u8, 252u8, 253u8, 254u8, 255u8 |])
+    val fname = "test_bytes.tmp"
+    Bytes.write(fname, b.slice(1, 3))
+    EXPECT_EQ(`Bytes.read(fname).array()`, [| 1u8, 2u8 |])
+    Sys.remove(fname)
+})
@@ -440,3 +440,22 @@ TEST("closure.self-refencing", fun()
     EXPECT_EQ(`leaf_printer(tree)`, "[[[[1]], [[2]]], [[[[3]]]], [[[[4]]], [[5]]]]")
     EXPECT_EQ(`leafs`, 5)
 })
+
+TEST("closure.non_escaping", fun()
+{
+    // the closures and the references that do not escape are allocated on stack,
+    // the others (like the ones stored in 'saved') must still be valid after the loop
+    fun walk(l: int list, f: int->void): void = match l { | x :: rest => f(x); walk(rest, f) | _ => {} }
+    fun count_if(l: int list, p: int->bool) { var n = 0; walk(l, fun (x) {if p(x) {n += 1}}); n }
+    val l = [1, 2, 3, 4, 5, 6]
+    var saved: (int->int) list = []
+    val fold s = 0 for k <- 1:4 {
+        val c = count_if(l, fun (x) {x % k == 0})
+        var total = 0
+        walk(l, fun (x) {total += x*k})
+        saved = (fun (x: int) {x + total}) :: saved
+        s + c*100 + total
+    }
+    EXPECT_EQ(`s`, 1226)
+    EXPECT_EQ(`[for f <- saved {f(1)}]`, [64, 43, 22])
+})
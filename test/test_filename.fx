@@ -4,7 +4,7 @@
 */
 
 from UTest import *
-import Filename
+import File, Filename, Sys
 
 TEST("filename.regression", fun() {
     val cwd = "/home/joe/project"
@@ -34,3 +34,14 @@ TEST("filename.regression", fun() {
         EXPECT_EQ(`Filename.normalize(cwd, path)`, norm)
     }
 })
+
+TEST("filename.touch", fun() {
+    val fname = f"__fx_touch_test_{Sys.tick_count()}.tmp"
+    EXPECT_EQ(`Filename.touch(fname)`, false)
+    File.write_utf8(fname, "test")
+    val t0 = Filename.getmtime(fname)
+    Sys.sleep(20)
+    EXPECT_EQ(`Filename.touch(fname)`, true)
+    EXPECT(Filename.getmtime(fname) > t0)
+    Sys.remove(fname)
+})
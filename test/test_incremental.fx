@@ -0,0 +1,123 @@
+/*
+    This file is a part of ficus language project.
+    See ficus/LICENSE for the licensing terms
+*/
+
+// checks that the incremental builds produce the same results as the full builds.
+// The tests use the compiler from <cwd>/bin, i.e. they should be run from the ficus root directory
+from UTest import *
+import File, Filename, Sys
+
+val ficus_exe = Filename.normalize(Filename.getcwd(), "bin/ficus")
+
+fun build_and_run(dir: string, main: string, ~opts: string=""): string
+{
+    val out = Filename.normalize(dir, "output.txt")
+    val cmd = f"cd {dir} && {ficus_exe} -O3 {opts} -run {main} > {out} 2>&1"
+    if Sys.command(cmd) != 0 { "" } else { File.read_utf8(out).strip() }
+}
+
+TEST("incremental.exported_consts", fun() {
+    if Sys.unix && Filename.exists(ficus_exe) {
+        val dir = Filename.normalize(Filename.getcwd(), f"__fxbuild__/incremental_{Sys.tick_count()}")
+        ignore(Sys.mkdir(Filename.dirname(dir), 0755))
+        ignore(Sys.mkdir(dir, 0755))
+        val amod = Filename.normalize(dir, "Amod.fx")
+        val main = Filename.normalize(dir, "main.fx")
+        File.write_utf8(main, "import Amod\nprintln(f\"{Amod.N} {Amod.K}\")\n")
+        File.write_utf8(amod, "val N = 10\nval K = N*2\n")
+        EXPECT_EQ(`build_and_run(dir, main)`, "10 20")
+        // 'main' must be recompiled, because the value of Amod.N could be substituted there
+        File.write_utf8(amod, "val N = 20\nval K = N*2\n")
+        EXPECT_EQ(`build_and_run(dir, main)`, "20 40")
+        File.write_utf8(amod, "val N = 20\nval K = N*3\n")
+        EXPECT_EQ(`build_and_run(dir, main)`, "20 60")
+        ignore(Sys.command(f"rm -rf {dir}"))
+    }
+})
+
+TEST("incremental.function_aliases", fun() {
+    if Sys.unix && Filename.exists(ficus_exe) {
+        val dir = Filename.normalize(Filename.getcwd(), f"__fxbuild__/incremental_{Sys.tick_count()}")
+        ignore(Sys.mkdir(Filename.dirname(dir), 0755))
+        ignore(Sys.mkdir(dir, 0755))
+        val amod = Filename.normalize(dir, "Amod.fx")
+        val bmod = Filename.normalize(dir, "Bmod.fx")
+        val main = Filename.normalize(dir, "main.fx")
+        File.write_utf8(main, "import Bmod\nprintln(f\"{Bmod.g(3)} {Bmod.inc(5)}\")\n")
+        File.write_utf8(amod, "fun inc1(x: int) = x + 1\nfun inc100(x: int) = x + 100\n")
+        File.write_utf8(bmod, "import Amod\nval inc = Amod.inc1\nfun g(x: int) = inc(x)*2\n")
+        EXPECT_EQ(`build_and_run(dir, main)`, "8 6")
+        File.write_utf8(bmod, "import Amod\nval inc = Amod.inc100\nfun g(x: int) = inc(x)*2\n")
+        EXPECT_EQ(`build_and_run(dir, main)`, "206 105")
+        ignore(Sys.command(f"rm -rf {dir}"))
+    }
+})
+
+TEST("incremental.split_c", fun() {
+    if Sys.unix && Filename.exists(ficus_exe) {
+        val dir = Filename.normalize(Filename.getcwd(), f"__fxbuild__/incremental_{Sys.tick_count()}")
+        ignore(Sys.mkdir(Filename.dirname(dir), 0755))
+        ignore(Sys.mkdir(dir, 0755))
+        val amod = Filename.normalize(dir, "Amod.fx")
+        val main = Filename.normalize(dir, "main.fx")
+        File.write_utf8(amod, "var counter = 0\n" +
+            "fun f1(x: int) { counter += 1; println(f\"f1({x})\"); x + 1 }\n" +
+            "fun f2(x: int) { counter += 1; println(f\"f2({x})\"); f1(x)*2 }\n" +
+            "fun f3(x: int) { counter += 1; println(f\"f3({x})\"); f2(x)*3 }\n" +
+            "fun f4(x: int) { counter += 1; println(f\"f4({x})\"); f3(x)*4 }\n")
+        File.write_utf8(main, "import Amod\nval r = Amod.f4(1)\nprintln(f\"{r} {Amod.counter}\")\n")
+        val expected = "f4(1)\nf3(1)\nf2(1)\nf1(1)\n48 4"
+        EXPECT_EQ(`build_and_run(dir, main, opts="-split-c 5")`, expected)
+        EXPECT_EQ(`Filename.exists(Filename.normalize(dir, "__fxbuild__/main/Amod.1.c"))`, true)
+        // the module that is not changed is not split again, but its parts should still be linked
+        File.write_utf8(main, "import Amod\nval r = Amod.f4(2)\nprintln(f\"{r} {Amod.counter}\")\n")
+        EXPECT_EQ(`build_and_run(dir, main, opts="-split-c 5")`, "f4(2)\nf3(2)\nf2(2)\nf1(2)\n72 4")
+        ignore(Sys.command(f"rm -rf {dir}"))
+    }
+})
+
+// waits (up to 60 seconds) until the compiler in the watch mode has done 'nbuilds' builds
+// or until it exits; returns the output of the application
+fun wait_builds(dir: string, nbuilds: int): string list
+{
+    val out = Filename.normalize(dir, "output.txt")
+    val status = Filename.normalize(dir, "status.txt")
+    var lines: string list = []
+    var i = 0
+    while i < 600 && lines.filter(fun (l) {l.startswith("Watching")}).length() < nbuilds &&
+          !Filename.exists(status) {
+        Sys.sleep(100)
+        if Filename.exists(out) { lines = File.read_utf8(out).split('\n', allow_empty=false) }
+        i += 1
+    }
+    [for l <- lines when !l.startswith("Watching") {l}]
+}
+
+TEST("incremental.watch", fun() {
+    if Sys.unix && Filename.exists(ficus_exe) {
+        val dir = Filename.normalize(Filename.getcwd(), f"__fxbuild__/incremental_{Sys.tick_count()}")
+        ignore(Sys.mkdir(Filename.dirname(dir), 0755))
+        ignore(Sys.mkdir(dir, 0755))
+        val amod = Filename.normalize(dir, "Amod.fx")
+        val main = Filename.normalize(dir, "main.fx")
+        val status = Filename.normalize(dir, "status.txt")
+        File.write_utf8(main, "import Amod\nprintln(Amod.N)\n")
+        File.write_utf8(amod, "val N = 10\n")
+        ignore(Sys.command(f"cd {dir} && ({ficus_exe} -O1 -run -watch {main} > output.txt 2>&1; \
+                             echo $? > status.txt) &"))
+        EXPECT_EQ(`wait_builds(dir, 1)`, ["10"])
+        File.write_utf8(amod, "val N = 20\n")
+        EXPECT_EQ(`wait_builds(dir, 2)`, ["10", "20"])
+        // saving the main file by deleting and re-creating it should trigger a rebuild
+        Sys.remove(main)
+        Sys.sleep(500)
+        File.write_utf8(main, "import Amod\nprintln(Amod.N + 1)\n")
+        EXPECT_EQ(`wait_builds(dir, 3)`, ["10", "20", "21"])
+        // the compiler should exit when the main file is removed for good
+        Sys.remove(main)
+        ignore(wait_builds(dir, 4))
+        EXPECT_EQ(`Filename.exists(status) && File.read_utf8(status).strip() == "0"`, true)
+        ignore(Sys.command(f"rm -rf {dir}"))
+    }
+})
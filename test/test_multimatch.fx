@@ -0,0 +1,37 @@
+/*
+    This file is a part of ficus language project.
+    See ficus/LICENSE for the licensing terms
+*/
+
+// tests for the multiple string matcher
+from UTest import *
+import Multimatch, Bytes
+
+TEST("multimatch.simple", fun() {
+    val mm = Multimatch.compile([| "he", "she", "his", "hers" |])
+    EXPECT_EQ(`mm.find_all("ushers")`, [| (1, 1), (0, 2), (3, 2) |])
+    EXPECT_EQ(`mm.find_all_str("this is his")`, [| ("his", 1), ("his", 8) |])
+    EXPECT_EQ(`mm.find_all("nothing here")`, [| (0, 8) |])
+    EXPECT_EQ(`mm.contains_any("xyz")`, false)
+    EXPECT_EQ(`mm.find_all(Bytes.from_string("ushers"))`, [| (1, 1), (0, 2), (3, 2) |])
+    val mm2 = Multimatch.compile([| "ab", "ab", "b", "абв", "бв" |])
+    EXPECT_EQ(`mm2.find_all("xabвабв")`, [| (0, 1), (1, 1), (2, 2), (3, 4), (4, 5) |])
+    // bytes are treated as Latin-1
+    val mm3 = Multimatch.compile([| "été", "ab" |])
+    EXPECT_EQ(`mm3.find_all(Bytes.from_array([| 0xe9u8, 116u8, 0xe9u8 |]))`, [| (0, 0) |])
+    EXPECT_EQ(`mm3.find_all(Bytes.from_string("été"))`, [])
+    EXPECT_THROWS(`fun () {ignore(Multimatch.compile([| "a", "" |]))}`, BadArgError)
+})
+
+TEST("multimatch.parallel", fun() {
+    val keywords = [| for i <- 0:1000 {f"key{i}_"} |]
+    val mm = Multimatch.compile(keywords)
+    val lines = [| for i <- 0:1000 {f"line {i}: key{i}_ key{(i*7)%1000}_ nokey"} |]
+    val found = [| @parallel for l <- lines {mm.find_all(l)} |]
+    val expected = [| for i <- 0:1000 {
+        val i1 = (i*7)%1000
+        val ofs = f"line {i}: key{i}_ ".length()
+        [| (i, ofs - f"key{i}_ ".length()), (i1, ofs) |]
+    } |]
+    EXPECT_EQ(`found`, expected)
+})
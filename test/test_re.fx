@@ -72,6 +72,81 @@ TEST("Re.groups", fun()
     EXPECT_EQ(`value`, "0x509F934")
 })
 
+TEST("Re.dfa", fun()
+{
+    val ab = Re.compile(r"a|ab")
+    val num = Re.compile(r"-?\d+(?:\.\d*)?")
+    val kw = Re.compile(r"fun\s+\w+")
+    val text = "0123456789abcdefghijklmnopqrstuvwxyz\n" * 100
+
+    // the preferred match, "a", does not span the whole string
+    EXPECT_EQ(`ab.fullmatch("ab")`, false)
+    EXPECT_EQ(`ab.fullmatch("a")`, true)
+    EXPECT_EQ(`ab.fullmatch("abb")`, false)
+    EXPECT_EQ(`Re.compile(r"a*?").fullmatch("aaa")`, false)
+    EXPECT_EQ(`Re.compile(r"\ba*?").fullmatch("aaa")`, false)
+    EXPECT_EQ(`Re.compile(r"ab|a").fullmatch("ab")`, true)
+    EXPECT_EQ(`num.fullmatch("-12.5")`, true)
+    EXPECT_EQ(`num.fullmatch("-12.5.")`, false)
+    EXPECT_EQ(`kw.fullmatch("FUN  Foo", ignorecase=true)`, true)
+    EXPECT_EQ(`kw.fullmatch("fun\nfoo", multiline=true)`, false)
+    EXPECT_EQ(`kw.find(text).issome()`, false)
+    EXPECT_EQ(`kw.find(text + "fun foo")`, Some([| (3700, 3707) |]))
+    EXPECT_EQ(`kw.findall_str(text + "fun foo; fun bar")`, [| "fun foo"; "fun bar" |])
+    EXPECT_EQ(`Re.compile(r"\bfun\b").fullmatch("fun")`, true)
+    // there are no alternatives, so the DFA answer is final
+    val code = Re.compile(r"ERR\d\d[a-f]")
+    EXPECT_EQ(`code.fullmatch("ERR12c")`, true)
+    EXPECT_EQ(`code.fullmatch("err12C", ignorecase=true)`, true)
+    EXPECT_EQ(`code.fullmatch("ERR12")`, false)
+    EXPECT_EQ(`code.fullmatch("ERR12cc")`, false)
+})
+
+TEST("Re.literals", fun()
+{
+    val log = "INFO 1 started\nWARNING 22 low memory\nERROR 333 out of memory\nERROR 4444 disk full\n"
+    val err = Re.compile(r"ERROR (\d+)")
+    val mem = Re.compile(r"\w+ memory")
+    val warn = Re.compile(r"WARN(?:ING)? \d+")
+
+    EXPECT_EQ(`err.find(log)`, Some([| (37, 46), (43, 46) |]))
+    EXPECT_EQ(`err.findall_str(log)`, [| "ERROR 333", "333"; "ERROR 4444", "4444" |])
+    EXPECT_EQ(`err.replace(log, r"E\1")`, "INFO 1 started\nWARNING 22 low memory\nE333 out of memory\nE4444 disk full\n")
+    EXPECT_EQ(`err.find("error 5 fatal").issome()`, false)
+    EXPECT_EQ(`err.find_str("error 5 fatal", ignorecase=true)`, Some([| "error 5", "5" |]))
+    EXPECT_EQ(`mem.find_str(log)`, Some([| "low memory" |]))
+    EXPECT_EQ(`warn.prefixmatch(log).issome()`, false)
+    EXPECT_EQ(`warn.prefixmatch(log[15:]).issome()`, true)
+    EXPECT_EQ(`warn.fullmatch("WARN 5")`, true)
+    EXPECT_EQ(`warn.fullmatch("WARNINGS 5")`, false)
+    // the literal must not be searched beyond the end of a substring
+    val tail = "xxxxab1"
+    EXPECT_EQ(`Re.compile(r"ab").find(tail[:5]).issome()`, false)
+    EXPECT_EQ(`Re.compile(r"ab\d*").find(tail[1:5]).issome()`, false)
+    EXPECT_EQ(`Re.compile(r"ab\d*").find(tail[1:])`, Some([| (3, 6) |]))
+})
+
+TEST("Re.const_pattern", fun()
+{
+    fun error_code(s: string) =
+        match Re.compile(r"ERROR (\d+)").find_str(s) {
+        | Some(m) => m[1].to_int_or(-1)
+        | _ => -1
+        }
+    EXPECT_EQ(`[for s <- ["ERROR 1", "WARNING 2", "ERROR 33"] {error_code(s)}]`, [1, -1, 33])
+})
+
+TEST("Re.match_many", fun()
+{
+    val num = Re.compile(r"-?\d+(?:\.\d*)?")
+    val lines = [| for i <- 0:1000 {if i % 3 == 0 {f"{i}.5"} else {f"x{i}"}} |]
+    val expected = [| for i <- 0:1000 {i % 3 == 0} |]
+    EXPECT_EQ(`Re.match_many(num, lines)`, expected)
+    EXPECT_EQ(`Re.match_many(Re.compile(r"x\d+"), lines)`, [| for f <- expected {!f} |])
+    EXPECT_EQ(`Re.match_many(Re.compile(r"X1+"), [| "x1", "X11", "x1x" |], ignorecase=true)`,
+              [| true, true, false |])
+})
+
 TEST("Re.exception", fun()
 {
     EXPECT_THROWS(`fun() {ignore(Re.compile(r"h.*o["))}`, BadArgError)
@@ -0,0 +1,41 @@
+/*
+    This file is a part of ficus language project.
+    See ficus/LICENSE for the licensing terms
+*/
+
+// tests for the ropes
+from UTest import *
+import Rope
+
+TEST("rope.edit", fun() {
+    val r = Rope.from_string("Hello, world!")
+    val r = r.insert(7, "wonderful ")
+    EXPECT_EQ(`r.string()`, "Hello, wonderful world!")
+    EXPECT_EQ(`r.length()`, 23)
+    EXPECT_EQ(`r.at(7)`, 'w')
+    EXPECT_EQ(`r.slice(7, 16).string()`, "wonderful")
+    EXPECT_EQ(`r.remove(5, 16).string()`, "Hello world!")
+    EXPECT_EQ(`(r + Rope.from_string(" Bye!")).string()`, "Hello, wonderful world! Bye!")
+    EXPECT_EQ(`r.slice(-5, 100) == r`, true)
+    EXPECT_THROWS(`fun () {ignore(r.at(23))}`, OutOfRangeError)
+})
+
+TEST("rope.many_edits", fun() {
+    // build the text by many small edits and compare with the plain string operations
+    val fold (r, s) = (Rope.empty(), "") for i <- 0:2000 {
+        val word = f"{i} "
+        val pos = (i * 7919) % (s.length() + 1)
+        (r.insert(pos, word), s[:pos] + word + s[pos:])
+    }
+    EXPECT_EQ(`r.length()`, s.length())
+    EXPECT_EQ(`r.string()`, s)
+    val fold (r, s) = (r, s) for i <- 0:500 {
+        val pos = (i * 104729) % s.length()
+        (r.remove(pos, pos + 3), s[:pos] + s[pos+3:])
+    }
+    EXPECT_EQ(`r.string()`, s)
+    EXPECT_EQ(`r.slice(1000, 1100).string()`, s[1000:1100])
+    var n = 0
+    r.app(fun (c) {if c == ' ' {n += 1}})
+    EXPECT_EQ(`n`, fold n = 0 for c <- s {if c == ' ' {n + 1} else {n}})
+})